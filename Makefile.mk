@@ -5,6 +5,7 @@ CC ?= cc
 CFLAGS ?= -Wall -g -O2 # Common flags: All warnings, debug symbols, optimization level 2
 CPPFLAGS ?= -Isrc      # Preprocessor flags, e.g., -I for include paths like "src/"
 LDFLAGS ?=             # Linker flags
+LDLIBS ?= -lpthread    # Libraries, the server runs a worker thread pool
 RM = rm -f             # Command for removing files
 
 # Source directory
@@ -18,8 +19,24 @@ HEADERS = $(SRC_DIR)/header.h
 # You could use a wildcard if all .c files in src/ should be compiled:
 # SOURCES = $(wildcard $(SRC_DIR)/*.c)
 SOURCES = $(SRC_DIR)/main.c \
+          $(SRC_DIR)/menu.c \
           $(SRC_DIR)/system.c \
           $(SRC_DIR)/auth.c \
+          $(SRC_DIR)/store.c \
+          $(SRC_DIR)/intern.c \
+          $(SRC_DIR)/wal.c \
+          $(SRC_DIR)/binstore.c \
+          $(SRC_DIR)/loader.c \
+          $(SRC_DIR)/ids.c \
+          $(SRC_DIR)/interest.c \
+          $(SRC_DIR)/snapshot.c \
+          $(SRC_DIR)/stats.c \
+          $(SRC_DIR)/password.c \
+          $(SRC_DIR)/uring.c \
+          $(SRC_DIR)/report.c \
+          $(SRC_DIR)/account.c \
+          $(SRC_DIR)/protocol.c \
+          $(SRC_DIR)/server.c \
           $(SRC_DIR)/kbd.c \
           $(SRC_DIR)/command.c \
           $(SRC_DIR)/display.c \
@@ -51,15 +68,35 @@ APP_INCLUDEDIR = $(DESTDIR)$(includedir)/atm
 # Local data files in the source tree to be removed by 'make clean'
 LOCAL_DATA_FILES_TO_CLEAN = ./share/atm/data/users.txt ./share/atm/data/records.txt
 
+# The interest projection loops are written to be auto-vectorized
+$(SRC_DIR)/interest.o: CFLAGS += -O3
+
+# Password hashes cost the same time to check as to forge, keep them optimized
+$(SRC_DIR)/password.o: CFLAGS += -O2
+
+# Reports scan every account of the book
+$(SRC_DIR)/report.o: CFLAGS += -O2
+
+# The bulk loader parses every byte of the records file
+$(SRC_DIR)/loader.o: CFLAGS += -O2
+
 # Default target: build the application
 all: $(TARGET)
 
 # Rule to link the target executable
 $(TARGET): $(OBJECTS)
 	@echo "Linking $(TARGET)..."
-	$(CC) $(LDFLAGS) -o $@ $(OBJECTS)
+	$(CC) $(LDFLAGS) -o $@ $(OBJECTS) $(LDLIBS)
 	@echo "$(TARGET) built successfully."
 
+# Benchmark tool, built on demand with `make bench`
+BENCH = bench
+BENCH_OBJECTS = $(SRC_DIR)/bench.o $(filter-out $(SRC_DIR)/main.o,$(OBJECTS))
+
+$(BENCH): $(BENCH_OBJECTS)
+	@echo "Linking $(BENCH)..."
+	$(CC) $(LDFLAGS) -o $@ $(BENCH_OBJECTS) $(LDLIBS)
+
 # Pattern rule to compile .c files from SRC_DIR to .o files in SRC_DIR
 # Recompiles if the .c file or any of the $(HEADERS) change.
 $(SRC_DIR)/%.o: $(SRC_DIR)/%.c $(HEADERS)
@@ -68,7 +105,7 @@ $(SRC_DIR)/%.o: $(SRC_DIR)/%.c $(HEADERS)
 
 clean:
 	@echo "Cleaning build artifacts..."
-	$(RM) $(TARGET) $(OBJECTS)
+	$(RM) $(TARGET) $(OBJECTS) $(BENCH) $(SRC_DIR)/bench.o
 	@echo "Cleaning local data files..."
 	$(RM) ./share/atm/data/users.txt
 	$(RM) ./share/atm/data/records.txt
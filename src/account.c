@@ -0,0 +1,637 @@
+/**
+ * @file account.c
+ * @brief Account operations of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * These functions hold the rules of every account operation without any
+ * prompting, so the terminal menus and the server protocol share them.
+ * Each one returns an OP_* result code.
+ *
+ * Concurrency control uses two levels of locks. Each shard of the store
+ * has its own lock, taken shared by operations that change existing
+ * accounts and exclusive by the ones that add or remove accounts or change
+ * their owner, since those move slots around or change the owner index;
+ * an operation only locks the shards of the
+ * accounts it touches. Under the shared shard lock, each account is
+ * guarded by one of LOCK_STRIPES mutexes chosen by hashing its number, so
+ * transactions on different accounts run in parallel. To stay deadlock
+ * free, an operation always takes the shard locks it needs first, in
+ * increasing shard order, then the stripes it needs in increasing stripe
+ * order, each lock once.
+ *
+ * A change is logged while its locks are held, but the operation waits
+ * for the log to reach the disk (syncLog) only after releasing them, so
+ * concurrent changes share one group commit.
+ *
+ * Every operation is timed from its first lock to its return, log sync
+ * included, in the operation statistics.
+ */
+
+#include "header.h"
+#include <pthread.h>
+
+/**
+ * @brief Stripe mutex padded to its own cache line
+ */
+struct Stripe
+{
+    pthread_mutex_t lock;
+    char pad[64 - sizeof(pthread_mutex_t) % 64];
+};
+
+static pthread_rwlock_t shardLocks[MAX_SHARDS];
+static struct Stripe stripes[LOCK_STRIPES];
+static pthread_once_t stripesOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Initialize the shard locks and the stripe mutexes
+ */
+static void initStripes(void)
+{
+    for (int i = 0; i < MAX_SHARDS; i++)
+    {
+        pthread_rwlock_init(&shardLocks[i], NULL);
+    }
+    for (int i = 0; i < LOCK_STRIPES; i++)
+    {
+        pthread_mutex_init(&stripes[i].lock, NULL);
+    }
+}
+
+/**
+ * @brief Lock one shard, shared or exclusive
+ */
+static void lockShard(int shard, int exclusive)
+{
+    pthread_once(&stripesOnce, initStripes);
+    if (exclusive)
+        pthread_rwlock_wrlock(&shardLocks[shard]);
+    else
+        pthread_rwlock_rdlock(&shardLocks[shard]);
+}
+
+/**
+ * @brief Release a shard lock
+ */
+static void unlockShard(int shard)
+{
+    pthread_rwlock_unlock(&shardLocks[shard]);
+}
+
+/**
+ * @brief Lock every shard, in increasing order
+ */
+static void lockAllShards(int exclusive)
+{
+    for (int k = 0; k < storeShards(); k++)
+    {
+        lockShard(k, exclusive);
+    }
+}
+
+/**
+ * @brief Release the locks taken by lockAllShards
+ */
+static void unlockAllShards(void)
+{
+    for (int k = storeShards() - 1; k >= 0; k--)
+    {
+        unlockShard(k);
+    }
+}
+
+/**
+ * @brief Get the stripe guarding an account
+ */
+static int stripeOf(int accountNbr)
+{
+    return ((unsigned int)accountNbr * 2654435769u) % LOCK_STRIPES;
+}
+
+/**
+ * @brief Lock the shards of some accounts shared, then their stripes
+ *
+ * @param accounts Account numbers the operation touches
+ * @param n Number of account numbers, at most 2
+ */
+static void lockAccounts(const int *accounts, int n)
+{
+    int a = stripeOf(accounts[0]);
+    int b = n > 1 ? stripeOf(accounts[1]) : a;
+    int s = shardOf(accounts[0]);
+    int t = n > 1 ? shardOf(accounts[1]) : s;
+
+    lockShard(s < t ? s : t, 0);
+    if (s != t)
+        lockShard(s < t ? t : s, 0);
+    pthread_mutex_lock(&stripes[a < b ? a : b].lock);
+    if (a != b)
+        pthread_mutex_lock(&stripes[a < b ? b : a].lock);
+}
+
+/**
+ * @brief Release the locks taken by lockAccounts
+ */
+static void unlockAccounts(const int *accounts, int n)
+{
+    int a = stripeOf(accounts[0]);
+    int b = n > 1 ? stripeOf(accounts[1]) : a;
+    int s = shardOf(accounts[0]);
+    int t = n > 1 ? shardOf(accounts[1]) : s;
+
+    if (a != b)
+        pthread_mutex_unlock(&stripes[b].lock);
+    pthread_mutex_unlock(&stripes[a].lock);
+    if (s != t)
+        unlockShard(t);
+    unlockShard(s);
+}
+
+/**
+ * @brief Drop the strings no account uses once the string pools have
+ * grown enough, checkpoint once the transaction log is long enough, and
+ * compact the slots of a shard once enough of them are tombstones
+ *
+ * Dropping strings renumbers them and a checkpoint reads every slot, so
+ * both run with every shard locked exclusively; a compaction only locks
+ * the shard it packs.
+ *
+ * @param shard Shard the operation changed
+ */
+static void maintainIfDue(int shard)
+{
+    if (!internRebuildDue() && !checkpointDue() && !compactionDue(shard))
+        return;
+    long long start = statsNow();
+    if (internRebuildDue() || checkpointDue())
+    {
+        lockAllShards(1);
+        if (internRebuildDue())
+            reclaimStrings();
+        if (checkpointDue())
+            checkpointRecords();
+        unlockAllShards();
+    }
+    if (compactionDue(shard))
+    {
+        lockShard(shard, 1);
+        if (compactionDue(shard))
+            compactRecords(shard);
+        unlockShard(shard);
+    }
+    statsEnd(STAT_CHECKPOINT, start, OP_OK);
+}
+
+/**
+ * @brief Get the message shown to the user for a result code
+ */
+const char *opMessage(int result)
+{
+    switch (result)
+    {
+    case OP_OK:
+        return "Success";
+    case OP_NO_ACCOUNT:
+        return "This account does not exist";
+    case OP_ACCOUNT_TAKEN:
+        return "This Account number is already used";
+    case OP_FIXED_ACCOUNT:
+        return "Cannot make transcations on fixed accounts";
+    case OP_NO_FUNDS:
+        return "Not enough money to make this transcation";
+    case OP_NO_USER:
+        return "The user provided does not exist";
+    case OP_USER_TAKEN:
+        return "User name already taken";
+    case OP_BAD_LOGIN:
+        return "Wrong password!! or User Name";
+    default:
+        return "Invalid operation";
+    }
+}
+
+/**
+ * @brief Open a new account for a user
+ *
+ * @param u Owner of the account
+ * @param r Account details; the id, owner and name are filled in
+ * @return OP_OK, OP_ACCOUNT_TAKEN or OP_INVALID
+ */
+int openAccount(struct User u, struct Record *r)
+{
+    long long start = statsBegin(STAT_CREATE);
+
+    toLowerCase(r->accountType);
+    if (checkValidDate(&r->deposit) != 0 || r->accountNbr < 0 || r->phone < 0 ||
+        r->amount < 0 || (r->type = accountTypeCode(r->accountType)) == TYPE_UNKNOWN)
+    {
+        statsEnd(STAT_CREATE, start, OP_INVALID);
+        return OP_INVALID;
+    }
+
+    r->userId = u.id;
+    strncpy(r->name, u.name, sizeof(r->name) - 1);
+    r->name[sizeof(r->name) - 1] = '\0';
+
+    int shard = shardOf(r->accountNbr);
+    lockShard(shard, 1);
+    if (findAccount(r->accountNbr, NULL))
+    {
+        unlockShard(shard);
+        statsEnd(STAT_CREATE, start, OP_ACCOUNT_TAKEN);
+        return OP_ACCOUNT_TAKEN;
+    }
+    r->id = allocateId(ID_RECORD);
+    insertAccount(r);
+    unlockShard(shard);
+    syncLog();
+    maintainIfDue(shard);
+    statsEnd(STAT_CREATE, start, OP_OK);
+    return OP_OK;
+}
+
+/**
+ * @brief Check whether an account number is already used
+ *
+ * Answered from the account index in memory, never from the disk.
+ */
+int accountTaken(int accountNbr)
+{
+    lockAccounts(&accountNbr, 1);
+    int taken = findAccount(accountNbr, NULL);
+    unlockAccounts(&accountNbr, 1);
+    return taken;
+}
+
+/**
+ * @brief Get one account of a user
+ *
+ * @return OP_OK or OP_NO_ACCOUNT
+ */
+int getAccount(struct User u, int accountNbr, struct Record *r)
+{
+    long long start = statsBegin(STAT_CHECK);
+
+    lockAccounts(&accountNbr, 1);
+    int found = findUserAccount(u, accountNbr, r);
+    unlockAccounts(&accountNbr, 1);
+    if (found)
+        statsRead(sizeof(struct Record));
+    statsEnd(STAT_CHECK, start, found ? OP_OK : OP_NO_ACCOUNT);
+    return found ? OP_OK : OP_NO_ACCOUNT;
+}
+
+/**
+ * @brief Callback of listAccounts and its argument
+ */
+struct ListCallback
+{
+    void (*fn)(const struct Record *, void *);
+    void *arg;
+};
+
+/**
+ * @brief Copy one account under its stripe and pass the copy on
+ */
+static void listOne(const struct Record *r, void *arg)
+{
+    struct ListCallback *callback = arg;
+    struct Record copy;
+    int stripe = stripeOf(r->accountNbr);
+
+    pthread_mutex_lock(&stripes[stripe].lock);
+    copy = *r;
+    pthread_mutex_unlock(&stripes[stripe].lock);
+    statsRead(sizeof(struct Record));
+    callback->fn(&copy, callback->arg);
+}
+
+/**
+ * @brief Call a function for every account of a user
+ *
+ * The function runs with every shard locked shared and must not call other operations.
+ */
+void listAccounts(struct User u, void (*fn)(const struct Record *, void *), void *arg)
+{
+    struct ListCallback callback = {fn, arg};
+    long long start = statsBegin(STAT_LIST);
+
+    lockAllShards(0);
+    forEachUserAccount(u, listOne, &callback);
+    unlockAllShards();
+    statsEnd(STAT_LIST, start, OP_OK);
+}
+
+/**
+ * @brief Call a function for every account of one shard
+ *
+ * Only that shard is locked, so the shards can be listed in parallel. The
+ * function runs under the shared shard lock and must not call other operations.
+ */
+void listShardAccounts(int shard, void (*fn)(const struct Record *, void *), void *arg)
+{
+    struct ListCallback callback = {fn, arg};
+
+    lockShard(shard, 0);
+    forEachShardAccount(shard, listOne, &callback);
+    unlockShard(shard);
+}
+
+/**
+ * @brief Call a function for every account of the bank, shard by shard
+ *
+ * Each shard is locked shared while it is listed. The function must not
+ * call other operations.
+ */
+void listAllAccounts(void (*fn)(const struct Record *, void *), void *arg)
+{
+    for (int k = 0; k < storeShards(); k++)
+    {
+        listShardAccounts(k, fn, arg);
+    }
+}
+
+/**
+ * @brief Run a function while no account can change
+ *
+ * Every shard is locked shared and every stripe is held, so the function
+ * sees one state of the whole book while the operations wait. It may read
+ * the store from any number of threads, but must not call other operations.
+ */
+void readAllAccounts(void (*fn)(void *), void *arg)
+{
+    lockAllShards(0);
+    for (int i = 0; i < LOCK_STRIPES; i++)
+    {
+        pthread_mutex_lock(&stripes[i].lock);
+    }
+    fn(arg);
+    for (int i = LOCK_STRIPES - 1; i >= 0; i--)
+    {
+        pthread_mutex_unlock(&stripes[i].lock);
+    }
+    unlockAllShards();
+}
+
+/**
+ * @brief Change the phone number or the country of an account
+ *
+ * @param phone New phone number, used when country is NULL
+ * @param country New country, or NULL to change the phone number
+ * @return OP_OK, OP_NO_ACCOUNT or OP_INVALID
+ */
+int changeAccountInfo(struct User u, int accountNbr, int phone, const char *country)
+{
+    struct Record r;
+    long long start = statsBegin(STAT_UPDATE);
+
+    if (country == NULL ? phone < 0 : checkValidType(country, "str") != 0)
+    {
+        statsEnd(STAT_UPDATE, start, OP_INVALID);
+        return OP_INVALID;
+    }
+
+    lockAccounts(&accountNbr, 1);
+    if (!findUserAccount(u, accountNbr, &r))
+    {
+        unlockAccounts(&accountNbr, 1);
+        statsEnd(STAT_UPDATE, start, OP_NO_ACCOUNT);
+        return OP_NO_ACCOUNT;
+    }
+    statsRead(sizeof(struct Record));
+    if (country != NULL)
+    {
+        strncpy(r.country, country, sizeof(r.country) - 1);
+        r.country[sizeof(r.country) - 1] = '\0';
+    }
+    else
+    {
+        r.phone = phone;
+    }
+    updateAccount(&r);
+    unlockAccounts(&accountNbr, 1);
+    syncLog();
+    maintainIfDue(shardOf(accountNbr));
+    statsEnd(STAT_UPDATE, start, OP_OK);
+    return OP_OK;
+}
+
+/**
+ * @brief Deposit to or withdraw from an account
+ *
+ * @param amount Amount to deposit, negative to withdraw
+ * @param balance Receives the new balance, may be NULL
+ * @return OP_OK, OP_NO_ACCOUNT, OP_FIXED_ACCOUNT or OP_NO_FUNDS
+ */
+int transact(struct User u, int accountNbr, double amount, double *balance)
+{
+    struct Record r;
+    int result = OP_OK;
+    long long start = statsBegin(STAT_TRANSACT);
+
+    lockAccounts(&accountNbr, 1);
+    if (!findUserAccount(u, accountNbr, &r))
+        result = OP_NO_ACCOUNT;
+    else if (!accountTypes[r.type].transactable)
+        result = OP_FIXED_ACCOUNT;
+    else if (r.amount + amount < 0)
+        result = OP_NO_FUNDS;
+    else
+    {
+        r.amount += amount;
+        updateBalance(accountNbr, r.amount);
+        if (balance != NULL)
+            *balance = r.amount;
+    }
+    unlockAccounts(&accountNbr, 1);
+    if (result != OP_NO_ACCOUNT)
+        statsRead(sizeof(struct Record));
+    syncLog();
+    maintainIfDue(shardOf(accountNbr));
+    statsEnd(STAT_TRANSACT, start, result);
+    return result;
+}
+
+/**
+ * @brief Move money from an account of a user to another account
+ *
+ * Both accounts are locked together, in shard and stripe order, and both
+ * new balances go to the log in one entry, so the money is never in both
+ * accounts or in neither, not even across a crash.
+ *
+ * @param fromNbr Account of the user to debit
+ * @param toNbr Account to credit, of any owner
+ * @param amount Amount to move, more than 0
+ * @param balance Receives the new balance of the debited account, may be NULL
+ * @return OP_OK, OP_NO_ACCOUNT, OP_FIXED_ACCOUNT, OP_NO_FUNDS or OP_INVALID
+ */
+int moveFunds(struct User u, int fromNbr, int toNbr, double amount, double *balance)
+{
+    struct Record from;
+    struct Record to;
+    int accounts[2] = {fromNbr, toNbr};
+    int result = OP_OK;
+    long long start = statsBegin(STAT_MOVE);
+
+    if (fromNbr == toNbr || !(amount > 0))
+    {
+        statsEnd(STAT_MOVE, start, OP_INVALID);
+        return OP_INVALID;
+    }
+    lockAccounts(accounts, 2);
+    if (!findUserAccount(u, fromNbr, &from) || !findAccount(toNbr, &to))
+        result = OP_NO_ACCOUNT;
+    else if (!accountTypes[from.type].transactable || !accountTypes[to.type].transactable)
+        result = OP_FIXED_ACCOUNT;
+    else if (from.amount - amount < 0)
+        result = OP_NO_FUNDS;
+    else
+    {
+        moveBalance(fromNbr, from.amount - amount, toNbr, to.amount + amount);
+        if (balance != NULL)
+            *balance = from.amount - amount;
+    }
+    unlockAccounts(accounts, 2);
+    if (result != OP_NO_ACCOUNT)
+        statsRead(2 * sizeof(struct Record));
+    syncLog();
+    maintainIfDue(shardOf(fromNbr));
+    statsEnd(STAT_MOVE, start, result);
+    return result;
+}
+
+/**
+ * @brief Remove an account of a user
+ *
+ * @param removed Receives the removed account, may be NULL
+ * @return OP_OK or OP_NO_ACCOUNT
+ */
+int closeAccount(struct User u, int accountNbr, struct Record *removed)
+{
+    struct Record r;
+    long long start = statsBegin(STAT_REMOVE);
+
+    int shard = shardOf(accountNbr);
+    lockShard(shard, 1);
+    if (!findUserAccount(u, accountNbr, &r))
+    {
+        unlockShard(shard);
+        statsEnd(STAT_REMOVE, start, OP_NO_ACCOUNT);
+        return OP_NO_ACCOUNT;
+    }
+    deleteAccount(accountNbr);
+    unlockShard(shard);
+    statsRead(sizeof(struct Record));
+    syncLog();
+    maintainIfDue(shardOf(accountNbr));
+    statsEnd(STAT_REMOVE, start, OP_OK);
+
+    if (removed != NULL)
+        *removed = r;
+    return OP_OK;
+}
+
+/**
+ * @brief Transfer the ownership of an account to another user
+ *
+ * @param username Name of the new owner
+ * @return OP_OK, OP_NO_ACCOUNT or OP_NO_USER
+ */
+int giveAccount(struct User u, int accountNbr, const char *username)
+{
+    struct Record r;
+    struct User p;
+    long long start = statsBegin(STAT_TRANSFER);
+
+    if (!findUser(username, &p))
+    {
+        statsEnd(STAT_TRANSFER, start, OP_NO_USER);
+        return OP_NO_USER;
+    }
+    statsRead(sizeof(struct User));
+
+    // the owner index is shared by every account of the shard
+    int shard = shardOf(accountNbr);
+    lockShard(shard, 1);
+    if (!findUserAccount(u, accountNbr, &r))
+    {
+        unlockShard(shard);
+        statsEnd(STAT_TRANSFER, start, OP_NO_ACCOUNT);
+        return OP_NO_ACCOUNT;
+    }
+    statsRead(sizeof(struct Record));
+    strncpy(r.name, p.name, sizeof(r.name) - 1);
+    r.name[sizeof(r.name) - 1] = '\0';
+    r.userId = p.id;
+    updateAccount(&r);
+    unlockShard(shard);
+    syncLog();
+    maintainIfDue(shardOf(accountNbr));
+    statsEnd(STAT_TRANSFER, start, OP_OK);
+    return OP_OK;
+}
+
+/**
+ * @brief Transfer the ownership of every account of a user, or of those of
+ * one type, to another user
+ *
+ * The accounts change owner together, under every shard lock, and the
+ * change is logged as a single entry.
+ *
+ * @param username Name of the new owner
+ * @param accountType Only give accounts of this known type, in any case, NULL for all
+ * @param given Receives the number of accounts given
+ * @return OP_OK, OP_NO_ACCOUNT if there was none to give, OP_NO_USER or
+ *         OP_INVALID if the type is unknown or the new owner is the user
+ */
+int giveAllAccounts(struct User u, const char *username, const char *accountType, int *given)
+{
+    char type[MAX_TRANSACTION_TYPE_SIZE];
+    struct User p;
+    long long start = statsBegin(STAT_TRANSFER_ALL);
+
+    *given = 0;
+    if (accountType != NULL)
+    {
+        if (strlen(accountType) >= sizeof(type))
+        {
+            statsEnd(STAT_TRANSFER_ALL, start, OP_INVALID);
+            return OP_INVALID;
+        }
+        strcpy(type, accountType);
+        toLowerCase(type);
+        if (accountTypeCode(type) == TYPE_UNKNOWN)
+        {
+            statsEnd(STAT_TRANSFER_ALL, start, OP_INVALID);
+            return OP_INVALID;
+        }
+        accountType = type;
+    }
+    if (!findUser(username, &p))
+    {
+        statsEnd(STAT_TRANSFER_ALL, start, OP_NO_USER);
+        return OP_NO_USER;
+    }
+    statsRead(sizeof(struct User));
+    if (p.id == u.id)
+    {
+        statsEnd(STAT_TRANSFER_ALL, start, OP_INVALID);
+        return OP_INVALID;
+    }
+
+    lockAllShards(1);
+    *given = reassignAccounts(u.id, u.name, p.id, p.name, accountType);
+    unlockAllShards();
+    if (*given == 0)
+    {
+        statsEnd(STAT_TRANSFER_ALL, start, OP_NO_ACCOUNT);
+        return OP_NO_ACCOUNT;
+    }
+    statsRead((size_t)*given * sizeof(struct Record));
+    syncLog();
+    // owners change in place, so no shard gets tombstones to compact
+    maintainIfDue(0);
+    statsEnd(STAT_TRANSFER_ALL, start, OP_OK);
+    return OP_OK;
+}
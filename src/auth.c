@@ -1,9 +1,395 @@
 #include <termios.h>
 #include "header.h"
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 
 char *USERS = "./data/users.txt";
 
+static struct User *users;  ///< Every user of the USERS file, in file order
+static int userCount;       ///< Number of loaded users
+static int userCapacity;    ///< Number of allocated users
+static long long usersBytes; ///< Size of the USERS file the table holds
+
+static int *userIndex;      ///< Open addressing table of user positions, -1 when empty
+static int userIndexCapacity; ///< Size of the table, always a power of two
+
+static pthread_rwlock_t usersLock = PTHREAD_RWLOCK_INITIALIZER; ///< Guards the user table
+
+/**
+ * @brief Hash a username into the user table (FNV-1a)
+ */
+static unsigned int hashName(const char *name)
+{
+    unsigned int h = 2166136261u;
+    while (*name)
+    {
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+    }
+    return h & (userIndexCapacity - 1);
+}
+
+/**
+ * @brief Insert a user position into the table, assumes the table has room
+ */
+static void userIndexPut(int pos)
+{
+    unsigned int i = hashName(users[pos].name);
+    while (userIndex[i] != -1)
+    {
+        i = (i + 1) & (userIndexCapacity - 1);
+    }
+    userIndex[i] = pos;
+}
+
+/**
+ * @brief Resize the table so its load factor stays under one half
+ */
+static void rebuildUserIndex(void)
+{
+    int capacity = 16;
+    while (capacity < userCount * 2)
+    {
+        capacity *= 2;
+    }
+    free(userIndex);
+    if ((userIndex = malloc(capacity * sizeof(int))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    userIndexCapacity = capacity;
+    memset(userIndex, -1, capacity * sizeof(int));
+    for (int pos = 0; pos < userCount; pos++)
+    {
+        userIndexPut(pos);
+    }
+}
+
+static const struct User *lookupUser(const char *name);
+
+/**
+ * @brief Add a user to the in-memory table
+ *
+ * A user already in the table is replaced: a later line of the USERS file
+ * for the same name, such as a migrated password, overrides the earlier ones.
+ */
+static void addUser(const struct User *u)
+{
+    const struct User *existing = lookupUser(u->name);
+    if (existing != NULL)
+    {
+        users[existing - users] = *u;
+        return;
+    }
+    if (userCount == userCapacity)
+    {
+        userCapacity = userCapacity ? userCapacity * 2 : 64;
+        if ((users = realloc(users, userCapacity * sizeof(struct User))) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+    }
+    users[userCount++] = *u;
+    if (userCount * 2 > userIndexCapacity)
+        rebuildUserIndex();
+    else
+        userIndexPut(userCount - 1);
+}
+
+/**
+ * @brief Load every user of the USERS file into memory
+ *
+ * When a snapshot exists, the users it holds are taken from it and only
+ * the part of the USERS file written after it is parsed.
+ *
+ * Must be called once before any other user lookup.
+ */
+void loadUsers(void)
+{
+    FILE *fp;
+    struct User u;
+    struct User *saved;
+    int savedCount;
+    long long savedBytes;
+
+    if ((fp = fopen(USERS, "r")) == NULL)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+
+    userCount = 0;
+    if ((saved = readSnapshotUsers(&savedCount, &savedBytes)) != NULL)
+    {
+        // a USERS file shorter than the snapshot knows was rewritten, parse all of it
+        if (fseek(fp, 0, SEEK_END) == 0 && ftell(fp) >= savedBytes && fseek(fp, savedBytes, SEEK_SET) == 0)
+        {
+            free(users);
+            users = saved;
+            userCount = savedCount;
+            userCapacity = savedCount + 1;
+            for (int pos = 0; pos < userCount; pos++)
+            {
+                reserveId(ID_USER, users[pos].id);
+            }
+        }
+        else
+        {
+            free(saved);
+            rewind(fp);
+        }
+    }
+
+    rebuildUserIndex();
+    while (fscanf(fp, "%d %49s %49s", &u.id, u.name, u.password) == 3)
+    {
+        addUser(&u);
+        reserveId(ID_USER, u.id);
+    }
+    fseek(fp, 0, SEEK_END);
+    usersBytes = ftell(fp);
+    fclose(fp);
+    rebuildUserIndex();
+}
+
+/**
+ * @brief Get the stored entry of a user, NULL if there is none
+ */
+static const struct User *lookupUser(const char *name)
+{
+    if (userIndexCapacity == 0)
+        return NULL;
+
+    unsigned int i = hashName(name);
+    while (userIndex[i] != -1)
+    {
+        if (strcmp(users[userIndex[i]].name, name) == 0)
+            return &users[userIndex[i]];
+        i = (i + 1) & (userIndexCapacity - 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Hash every password still stored in plaintext
+ *
+ * The hashes are appended to the USERS file, where they override the
+ * plaintext lines, so the file and the snapshot stay consistent even if
+ * the migration is interrupted. Passwords are queued to the hashing pool
+ * PASSWORD_QUEUE at a time, which keeps every worker of the pool busy.
+ *
+ * @return Number of passwords migrated
+ */
+int migratePasswords(void)
+{
+    struct User *batch;
+    char (*plaintext)[MAX_PASSWORD_SIZE];
+    const char *passwords[PASSWORD_QUEUE];
+    char *hashes[PASSWORD_QUEUE];
+    FILE *fp;
+    int migrated = 0;
+
+    if ((batch = malloc(PASSWORD_QUEUE * sizeof(struct User))) == NULL ||
+        (plaintext = malloc(PASSWORD_QUEUE * sizeof(*plaintext))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    if ((fp = fopen(USERS, "a")) == NULL)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+
+    pthread_rwlock_wrlock(&usersLock);
+    for (int pos = 0; pos < userCount;)
+    {
+        int n = 0;
+        for (; pos < userCount && n < PASSWORD_QUEUE; pos++)
+        {
+            if (!passwordHashed(users[pos].password, NULL))
+            {
+                batch[n] = users[pos];
+                strcpy(plaintext[n], users[pos].password);
+                passwords[n] = plaintext[n];
+                hashes[n] = batch[n].password;
+                n++;
+            }
+        }
+        hashPasswords(passwords, hashes, n);
+        for (int i = 0; i < n; i++)
+        {
+            fprintf(fp, "%d %s %s\n", batch[i].id, batch[i].name, batch[i].password);
+            addUser(&batch[i]);
+        }
+        migrated += n;
+    }
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+    {
+        printf("Error! writing file");
+        exit(1);
+    }
+    if (migrated > 0)
+        usersBytes = ftell(fp);
+    pthread_rwlock_unlock(&usersLock);
+    fclose(fp);
+    free(plaintext);
+    free(batch);
+    return migrated;
+}
+
+/**
+ * @brief Lock the user table against registrations, for a snapshot
+ */
+void lockUsers(void)
+{
+    pthread_rwlock_rdlock(&usersLock);
+}
+
+/**
+ * @brief Release the lock taken by lockUsers
+ */
+void unlockUsers(void)
+{
+    pthread_rwlock_unlock(&usersLock);
+}
+
+/**
+ * @brief Get the user table, only while it is locked by lockUsers
+ *
+ * @param count Receives the number of users
+ * @param bytes Receives the size of the USERS file the table holds
+ */
+const struct User *userTable(int *count, long long *bytes)
+{
+    *count = userCount;
+    *bytes = usersBytes;
+    return users;
+}
+
+/**
+ * @brief Find a user by username
+ *
+ * @param name Username to look up
+ * @param u Receives a copy of the user when found, may be NULL
+ * @return 1 if the user exists, 0 otherwise
+ */
+int findUser(const char *name, struct User *u)
+{
+    pthread_rwlock_rdlock(&usersLock);
+    const struct User *found = lookupUser(name);
+    if (found != NULL && u != NULL)
+        *u = *found;
+    pthread_rwlock_unlock(&usersLock);
+    return found != NULL;
+}
+
+/**
+ * @brief Append a user to the USERS file and to the table, caller holds the lock
+ */
+static void appendUser(struct User *u)
+{
+    FILE *fp;
+    if ((fp = fopen(USERS, "a")) == NULL) {
+        printf("Error! opening file");
+        exit(1);
+    }
+    statsWritten(fprintf(fp, "%d %s %s\n", 
+    u->id,
+    u->name,
+    u->password
+    ));
+
+    // a registration is acknowledged, so it must survive a crash
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+        printf("Error! writing file");
+        exit(1);
+    }
+    usersBytes = ftell(fp);
+    fclose(fp);
+    addUser(u);
+}
+
+/**
+ * @brief Check the credentials of a user
+ *
+ * The password is checked on the hashing pool. A password stored in
+ * plaintext or hashed at another cost is hashed again at the current cost
+ * once it matched, and the new hash is appended to the USERS file.
+ *
+ * @param u User with the name and password filled in, receives the id
+ * @return OP_OK or OP_BAD_LOGIN
+ */
+int loginUser(struct User *u)
+{
+    struct User found;
+    long long start = statsBegin(STAT_LOGIN);
+
+    if (!findUser(u->name, &found) || !checkPassword(u->password, found.password))
+    {
+        statsEnd(STAT_LOGIN, start, OP_BAD_LOGIN);
+        return OP_BAD_LOGIN;
+    }
+    statsRead(sizeof(struct User));
+    u->id = found.id;
+
+    if (passwordOutdated(found.password))
+    {
+        struct User rehashed = found;
+        hashPassword(u->password, rehashed.password);
+        pthread_rwlock_wrlock(&usersLock);
+        // a concurrent login of the same user may have migrated it already
+        const struct User *current = lookupUser(found.name);
+        if (current != NULL && strcmp(current->password, found.password) == 0)
+            appendUser(&rehashed);
+        pthread_rwlock_unlock(&usersLock);
+    }
+    statsEnd(STAT_LOGIN, start, OP_OK);
+    return OP_OK;
+}
+
+/**
+ * @brief Register a new user
+ *
+ * @param u User with the name and password filled in, receives the id
+ * @return OP_OK, OP_USER_TAKEN or OP_INVALID
+ */
+int registerNewUser(struct User *u)
+{
+    struct User stored;
+    long long start = statsBegin(STAT_REGISTER);
+
+    if (strlen(u->name) == 0 || strlen(u->password) == 0)
+    {
+        statsEnd(STAT_REGISTER, start, OP_INVALID);
+        return OP_INVALID;
+    }
+    if (findUser(u->name, NULL))
+    {
+        statsEnd(STAT_REGISTER, start, OP_USER_TAKEN);
+        return OP_USER_TAKEN;
+    }
+
+    // hash before locking, the lock only covers the append
+    stored = *u;
+    hashPassword(u->password, stored.password);
+
+    pthread_rwlock_wrlock(&usersLock);
+    if (lookupUser(u->name) != NULL)
+    {
+        pthread_rwlock_unlock(&usersLock);
+        statsEnd(STAT_REGISTER, start, OP_USER_TAKEN);
+        return OP_USER_TAKEN;
+    }
+    u->id = stored.id = setId();
+    appendUser(&stored);
+    pthread_rwlock_unlock(&usersLock);
+    statsEnd(STAT_REGISTER, start, OP_OK);
+    return OP_OK;
+}
+
 /**
  * @brief Login menu for user authentication
  * 
@@ -18,7 +404,7 @@ void loginMenu(char a[MAX_USERNAME_SIZE], char pass[MAX_PASSWORD_SIZE])
     struct termios oflags, nflags;
     char buffer[100];
 
-    system("clear");
+    clearScreen();
     printf("\n\n\n\t\t\t\t   Bank Management System\n\t\t\t\t\t User Login:");
     fgets(buffer,100,stdin);
     checkBuffer(buffer);
@@ -60,7 +446,7 @@ void loginMenu(char a[MAX_USERNAME_SIZE], char pass[MAX_PASSWORD_SIZE])
 void registerUser(char a[MAX_USERNAME_SIZE], char pass[MAX_PASSWORD_SIZE]) 
 {
     char buffer[100];
-    system("clear");
+    clearScreen();
 name:
     printf("\n\n\n\t\t\t\t   Bank Management System\n\t\t\t\t\t UserName:");
     fgets(buffer,100,stdin);
@@ -89,33 +475,15 @@ pass:
 /**
  * @brief Get the username of a user
  * 
- * This function searches the USERS file for a user with the specified username and returns it.
+ * This function looks the user table up for a user with the specified username and returns it.
  * 
  * @param u User structure containing the username
  * @return The username if found, otherwise "no user found"
  */
 const char *getUserName(struct User u)
 {
-    FILE *fp;
-    char data[256];
-
-    if ((fp = fopen(USERS, "r")) == NULL)
-    {
-        printf("Error! opening the file");
-        exit(1);
-    }
-
-    while (fgets(data, sizeof(data), fp) != NULL)
-    {
-        char* piece = strtok(data, " ");
-        piece = strtok(NULL, " ");
-        if (strcmp(piece, u.name)==0) {
-            fclose(fp);
-            return piece;
-        }
-    }
-    fclose(fp);
-    return "no user found";
+    const struct User *found = lookupUser(u.name);
+    return found ? found->name : "no user found";
 }
 
 /**
@@ -125,117 +493,50 @@ const char *getUserName(struct User u)
  */
 const char *getPassword(struct User u)
 {
-    FILE *fp;
-    char data[256];
-
-    if ((fp = fopen(USERS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-
-    while (fgets(data,sizeof(data), fp ) != NULL)
-    {
-        char* piece = strtok(data, " ");
-        piece = strtok(NULL, " ");
-        if (strcmp(piece, u.name) == 0) 
-        {
-            fclose(fp);
-            piece = strtok(NULL, " ");
-            piece[strcspn(piece, "\n")] = 0;
-            return piece;
-        } 
-    }
-
-    fclose(fp);
-    return "no user found";
+    const struct User *found = lookupUser(u.name);
+    return found ? found->password : "no user found";
 }
 
 /**
  * @brief Set the ID for a new user
  * 
- * This function reads the USERS file and counts the number of lines to determine the next available ID.
+ * Ids come from the persistent id counter, so they stay unique however
+ * the USERS file changes.
  * 
- * @return The next available user ID
+ * @return A user ID never handed out before
  */
 const int setId()
 {
-    FILE *fp;
-    char data[256];
-    int count = 0;
-
-    if ((fp = fopen(USERS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-
-    while (fgets(data,sizeof(data), fp ) != NULL)
-    {
-        count++; 
-    }
-    fclose(fp);
-    return  count;   
+    return allocateId(ID_USER);
 }
 
 /**
  * @brief Get the ID of a user based on their username
  * 
- * This function searches the USERS file for a user with the specified username and returns their ID.
+ * This function looks the user table up for a user with the specified username and returns their ID.
  * 
  * @param u User structure containing the username
  * @return The ID of the user if found, otherwise -1
  */
 const int getId(struct User u)
 {
-    FILE *fp;
-    char data[256];
-    char *initial;
-    int id;
-
-    if ((fp = fopen(USERS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-
-    while (fgets(data,sizeof(data), fp ) != NULL)
-    {
-        char *piece = strtok(data, " ");
-        initial = piece;
-        piece = strtok(NULL, " ");
-        if (strcmp(u.name, piece) == 0)
-        {
-            id = atoi(initial);
-        }
-
-
-    }
-    fclose(fp);
-    return id;
+    const struct User *found = lookupUser(u.name);
+    return found ? found->id : -1;
 }
 
 /**
  * @brief Save a new user to the USERS file
  * 
- * This function appends a new user's information to the USERS file.
+ * This function appends a new user's information to the USERS file and
+ * adds it to the user table.
  * 
  * @param u Pointer to a User structure containing user information
  */
 void saveUser(struct User *u)
 {
-    FILE *fp;
-    if ((fp = fopen(USERS, "a")) == NULL) {
-        printf("Error! opening file");
-        exit(1);
-    }
-    fprintf(fp, "%d %s %s\n", 
-    u->id,
-    u->name,
-    u->password
-    );
-
-    fclose(fp);
+    pthread_rwlock_wrlock(&usersLock);
+    appendUser(u);
+    pthread_rwlock_unlock(&usersLock);
 }
 
 /**
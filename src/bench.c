@@ -0,0 +1,1580 @@
+/**
+ * @file bench.c
+ * @brief Benchmarks of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * Every benchmark runs on a scratch data directory under /tmp so the real
+ * ./data files are never touched.
+ *
+ * Usage:
+ *   bench generate <users> <records> [directory]
+ *     Writes synthetic users.txt and records.txt into directory/data
+ *     (the current directory by default).
+ *   bench run <records> [users] [ops] [--sync]
+ *     Generates a book of that size and times the record parser and
+ *     formatter, the user lookups and every account operation. Prints the
+ *     ops/sec and the p50/p99 latencies of each. The log is not synced
+ *     unless --sync is given.
+ *   bench parse <records>
+ *     Loads a generated book, followed by some unusual records, with both
+ *     getAccountFromFile and the bulk loader, checks that they read the same
+ *     records field by field and prints the time each took.
+ *   bench interest <records>
+ *     Projects the interest of every account of a generated book with the
+ *     interest table and with a scalar loop over the records, checks that
+ *     both agree and prints the accounts/sec of each.
+ *   bench commit [max threads] [deposits per thread]
+ *     Runs durable deposits under group commit, with and without a commit
+ *     window, next to deposits that are never synced.
+ *   bench startup <records>
+ *     Times a cold start from the text files and from a snapshot, and how
+ *     long taking the snapshot locks the store.
+ *   bench stats [ops]
+ *     Checks the percentiles of the operation statistics against the exact
+ *     percentiles of known latencies, times what recording an operation
+ *     costs next to a deposit and prints the statistics of the run.
+ *   bench password [threads] [logins per cost]
+ *     Checks PBKDF2-HMAC-SHA256 against known vectors, then prints the
+ *     logins/sec of that many concurrent sessions at each hash cost. The
+ *     logins are divided by four at each cost, which quadruples their price.
+ *   bench locks [max threads] [accounts]
+ *     Runs deposits on many thread counts, once spread over all accounts and
+ *     once on a single hot account, and prints the throughput of each run.
+ *   bench moves [max threads] [accounts] [moves per thread]
+ *     Runs durable moves between random pairs of a few accounts on many
+ *     thread counts, once with MOVE and once as a withdrawal followed by a
+ *     deposit, checks each move took one log entry and no money was made
+ *     or lost, and prints the moves/sec of each.
+ *   bench mixed [threads] [ops per thread]
+ *     Runs balance checks mixed with one durable deposit in five, with the
+ *     log written with pwrite and fdatasync and then through io_uring, and
+ *     prints the read and write latencies of each.
+ *   bench shards <records> [max shards]
+ *     Splits a generated book into 1, 2, 4... shards, checks each layout
+ *     holds every account and prints how long loading and rewriting the
+ *     records files take.
+ *   bench report <records> [max threads]
+ *     Runs the aggregate report of a generated book on 1, 2, 4... threads,
+ *     checks every run prints the same report with the right bank total and
+ *     prints the accounts/sec of each.
+ *   bench memory <records>
+ *     Loads a generated book, checks every account reads back as it was
+ *     written, from the records file and from a snapshot, and prints the
+ *     bytes per account of the store next to the struct Record layout.
+ */
+
+#include "header.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_OPS_PER_THREAD 200000
+#define BENCH_DEFAULT_OPS 10000
+
+extern const char *RECORDS;
+
+static char scratch[] = "/tmp/atm-bench-XXXXXX";
+static struct User benchUser;
+
+static const char *benchCountries[] = {"Portugal", "UK", "Kenya", "France", "Brazil", "Japan", "Canada", "India"};
+static const char *benchTypes[] = {"saving", "current", "fixed01", "fixed02", "fixed03"};
+
+/**
+ * @brief Get a monotonic timestamp in seconds
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Remove the scratch data directory
+ */
+static void removeScratch(void)
+{
+    char path[512];
+    struct dirent *entry;
+    DIR *dir;
+
+    snprintf(path, sizeof(path), "%s/data", scratch);
+    if ((dir = opendir(path)) != NULL)
+    {
+        while ((entry = readdir(dir)) != NULL)
+        {
+            snprintf(path, sizeof(path), "%s/data/%s", scratch, entry->d_name);
+            remove(path);
+        }
+        closedir(dir);
+    }
+    snprintf(path, sizeof(path), "%s/data", scratch);
+    rmdir(path);
+    rmdir(scratch);
+}
+
+/**
+ * @brief Move to a fresh, empty scratch data directory
+ */
+static void openScratch(void)
+{
+    if (mkdtemp(scratch) == NULL || chdir(scratch) != 0)
+    {
+        perror("scratch directory");
+        exit(1);
+    }
+    atexit(removeScratch);
+    initSystem();
+}
+
+/**
+ * @brief Fill the user of the n-th synthetic user
+ */
+static void syntheticUser(int n, struct User *u)
+{
+    u->id = n;
+    snprintf(u->name, sizeof(u->name), "user%d", n);
+    snprintf(u->password, sizeof(u->password), "pass%d", n);
+}
+
+/**
+ * @brief Fill the n-th synthetic record, owned by user n % users
+ */
+static void syntheticRecord(int n, int users, unsigned int *seed, struct Record *r)
+{
+    struct User owner;
+
+    memset(r, 0, sizeof(*r));
+    syntheticUser(n % users, &owner);
+    r->id = n + 1;
+    r->userId = owner.id;
+    strcpy(r->name, owner.name);
+    r->accountNbr = n;
+    r->deposit.month = rand_r(seed) % 12 + 1;
+    r->deposit.day = rand_r(seed) % 28 + 1;
+    r->deposit.year = 1990 + rand_r(seed) % 35;
+    strcpy(r->country, benchCountries[rand_r(seed) % 8]);
+    r->phone = rand_r(seed) % 1000000000;
+    r->amount = (rand_r(seed) % 10000000) / 100.0;
+    // most accounts accept transactions, like in a real book
+    strcpy(r->accountType, benchTypes[rand_r(seed) % 10 < 8 ? rand_r(seed) % 2 : 2 + rand_r(seed) % 3]);
+}
+
+/**
+ * @brief Write synthetic users.txt and records.txt into ./data
+ */
+static void generate(int users, int records)
+{
+    struct User u;
+    struct Record r;
+    unsigned int seed = 42;
+    FILE *fp;
+
+    if ((fp = fopen("./data/users.txt", "w")) == NULL)
+    {
+        perror("users.txt");
+        exit(1);
+    }
+    for (int i = 0; i < users; i++)
+    {
+        syntheticUser(i, &u);
+        fprintf(fp, "%d %s %s\n", u.id, u.name, u.password);
+    }
+    fclose(fp);
+
+    if ((fp = fopen("./data/records.txt", "w")) == NULL)
+    {
+        perror("records.txt");
+        exit(1);
+    }
+    for (int i = 0; i < records; i++)
+    {
+        syntheticRecord(i, users, &seed, &r);
+        saveAccountToFile(fp, &r);
+    }
+    fclose(fp);
+}
+
+/**
+ * @brief Compare two latencies for qsort
+ */
+static int compareLatency(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Print the throughput and latency percentiles of an operation
+ *
+ * @param name Name of the operation
+ * @param samples Latency of every call in seconds, sorted in place
+ * @param count Number of calls
+ */
+static void report(const char *name, double *samples, int count)
+{
+    double total = 0;
+
+    if (count == 0)
+        return;
+    for (int i = 0; i < count; i++)
+    {
+        total += samples[i];
+    }
+    qsort(samples, count, sizeof(double), compareLatency);
+    printf("%-22s %10d %14.0f %12.2f %12.2f\n", name, count, count / total,
+           samples[count / 2] * 1e6, samples[(int)(count * 0.99)] * 1e6);
+}
+
+/**
+ * @brief Time the record parser over the whole records file
+ */
+static void benchParse(double *samples)
+{
+    struct Record r;
+    FILE *fp;
+    int count = 0;
+
+    if ((fp = fopen(RECORDS, "r")) == NULL)
+    {
+        perror("records.txt");
+        exit(1);
+    }
+    for (;;)
+    {
+        double start = now();
+        if (!getAccountFromFile(fp, &r))
+            break;
+        samples[count++] = now() - start;
+    }
+    fclose(fp);
+    report("getAccountFromFile", samples, count);
+}
+
+/**
+ * @brief Time the record formatter
+ */
+static void benchFormat(double *samples, int records)
+{
+    struct Record r;
+    unsigned int seed = 7;
+    FILE *fp;
+
+    if ((fp = fopen("/dev/null", "w")) == NULL)
+    {
+        perror("/dev/null");
+        exit(1);
+    }
+    for (int i = 0; i < records; i++)
+    {
+        syntheticRecord(i, 1, &seed, &r);
+        double start = now();
+        saveAccountToFile(fp, &r);
+        samples[i] = now() - start;
+    }
+    fclose(fp);
+    report("saveAccountToFile", samples, records);
+}
+
+/**
+ * @brief Time the full load of the store and the user table
+ */
+static void benchLoad(void)
+{
+    double start = now();
+    loadRecords();
+    double records = now() - start;
+
+    start = now();
+    loadUsers();
+    printf("%-22s %10s %14s %12.2f ms\n", "loadRecords", "", "", records * 1e3);
+    printf("%-22s %10s %14s %12.2f ms\n", "loadUsers", "", "", (now() - start) * 1e3);
+}
+
+/**
+ * @brief Time the user lookups of login and registration
+ */
+static void benchUsers(double *samples, int ops, int users)
+{
+    struct User u;
+    unsigned int seed = 11;
+
+    for (int i = 0; i < ops; i++)
+    {
+        syntheticUser(rand_r(&seed) % users, &u);
+        double start = now();
+        getId(u);
+        samples[i] = now() - start;
+    }
+    report("getId", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        syntheticUser(rand_r(&seed) % users, &u);
+        double start = now();
+        getPassword(u);
+        samples[i] = now() - start;
+    }
+    report("getPassword", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        syntheticUser(rand_r(&seed) % users, &u);
+        double start = now();
+        loginUser(&u);
+        samples[i] = now() - start;
+    }
+    report("login", samples, ops);
+}
+
+/**
+ * @brief Count the records passed to a callback
+ */
+static void countRecord(const struct Record *r, void *arg)
+{
+    (void)r;
+    (*(int *)arg)++;
+}
+
+/**
+ * @brief Time every account operation
+ *
+ * Transactions and updates hit random accounts of the first half of the
+ * book, transfers and removals walk their own disjoint ranges of the
+ * second half so each call finds its account.
+ */
+static void benchOperations(double *samples, int ops, int records, int users)
+{
+    struct User u;
+    struct Record r;
+    unsigned int seed = 13;
+    int result;
+
+    for (int i = 0; i < ops; i++)
+    {
+        syntheticRecord(records + i, users, &seed, &r);
+        syntheticUser(r.userId, &u);
+        double start = now();
+        result = openAccount(u, &r);
+        samples[i] = now() - start;
+        if (result != OP_OK)
+            printf("create failed: %s\n", opMessage(result));
+    }
+    report("create", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        int account = i % 2 ? rand_r(&seed) % records : records + ops + rand_r(&seed) % records;
+        double start = now();
+        accountTaken(account);
+        samples[i] = now() - start;
+    }
+    report("accountTaken", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        int account = rand_r(&seed) % (records / 2);
+        syntheticUser(account % users, &u);
+        double start = now();
+        transact(u, account, 1.0, NULL);
+        samples[i] = now() - start;
+    }
+    report("transact", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        int account = rand_r(&seed) % (records / 2);
+        syntheticUser(account % users, &u);
+        double start = now();
+        changeAccountInfo(u, account, i, NULL);
+        samples[i] = now() - start;
+    }
+    report("update", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        int listed = 0;
+        syntheticUser(rand_r(&seed) % users, &u);
+        double start = now();
+        listAccounts(u, countRecord, &listed);
+        samples[i] = now() - start;
+    }
+    report("list", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        struct User to;
+        int account = records / 2 + i;
+        syntheticUser(account % users, &u);
+        syntheticUser((account + 1) % users, &to);
+        double start = now();
+        giveAccount(u, account, to.name);
+        samples[i] = now() - start;
+    }
+    report("transfer", samples, ops);
+
+    for (int i = 0; i < ops; i++)
+    {
+        int account = records * 3 / 4 + i;
+        syntheticUser(account % users, &u);
+        double start = now();
+        closeAccount(u, account, NULL);
+        samples[i] = now() - start;
+    }
+    report("remove", samples, ops);
+}
+
+/**
+ * @brief Run the whole suite on a synthetic book
+ */
+static void benchRun(int records, int users, int ops, int sync)
+{
+    double *samples;
+
+    if (ops > records / 4)
+        ops = records / 4;
+    if ((samples = malloc((records > ops ? records : ops) * sizeof(double))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+
+    generate(users, records);
+    printf("%d records, %d users, %d ops per operation, log %s\n", records, users, ops, sync ? "synced" : "not synced");
+    printf("%-22s %10s %14s %12s %12s\n", "operation", "calls", "ops/sec", "p50 (us)", "p99 (us)");
+    benchParse(samples);
+    benchFormat(samples, records);
+    benchLoad();
+    setLogSync(sync);
+    benchUsers(samples, ops, users);
+    benchOperations(samples, ops, records, users);
+    free(samples);
+}
+
+/**
+ * @brief Records read by the bulk loader
+ */
+struct LoadedRecords
+{
+    struct Record *records;
+    int count;
+};
+
+/**
+ * @brief Keep a record read by the bulk loader
+ */
+static void keepRecord(const struct Record *r, void *arg)
+{
+    struct LoadedRecords *loaded = arg;
+    loaded->records[loaded->count++] = *r;
+}
+
+/**
+ * @brief Check that the bulk loader reads the same records as getAccountFromFile
+ */
+static int benchParser(int records)
+{
+    // spacing, signs, long strings, exponents and a torn last record
+    const char *unusual =
+        "7 3 alice 12 1/2/2003 UK 5 0.1 saving\n"
+        "8\t4  bob -12 12/31/1999\tFrance -5 -0.00 current\r\n"
+        "9 5 carol 13 2/ 3/2004 Kenya 6 1e3 fixed01\n"
+        "10 6 dave 14 3/4/2005 Peru 7 123456789012345678.25 fixed02\n"
+        "11 7 eve 15 4/5/2006 Chile 8 .5 saving\n"
+        "12 8 frank 16 5/6/2007 Japan 9 3. current\n"
+        "13 9 grace 17 6/7/2008 Spain 10 1.005 current\n"
+        "14 10 heidi 18 7/8/2009 Italy 11 9007199254740993 saving\n"
+        "15 11 ivan 19 8/9/2010 Chad";
+    struct LoadedRecords loaded;
+    struct Record r;
+    FILE *fp;
+    int count = 0;
+    int errors = 0;
+
+    generate(records / 10 + 1, records);
+    if ((fp = fopen(RECORDS, "a")) == NULL)
+    {
+        perror("records.txt");
+        exit(1);
+    }
+    fputs(unusual, fp);
+    fclose(fp);
+
+    if ((loaded.records = calloc(records + 16, sizeof(struct Record))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    loaded.count = 0;
+    loadRecordFile(RECORDS, keepRecord, &loaded);
+
+    // time both readers without keeping the records
+    double start = now();
+    loadRecordFile(RECORDS, countRecord, &count);
+    double bulk = now() - start;
+
+    start = now();
+    if ((fp = fopen(RECORDS, "r")) == NULL)
+    {
+        perror("records.txt");
+        exit(1);
+    }
+    while (getAccountFromFile(fp, &r))
+    {
+    }
+    double scanned = now() - start;
+
+    rewind(fp);
+    count = 0;
+    memset(&r, 0, sizeof(r));
+    while (getAccountFromFile(fp, &r))
+    {
+        const struct Record *b = &loaded.records[count];
+        if (count >= loaded.count ||
+            b->id != r.id || b->userId != r.userId || strcmp(b->name, r.name) != 0 ||
+            b->accountNbr != r.accountNbr || b->deposit.month != r.deposit.month ||
+            b->deposit.day != r.deposit.day || b->deposit.year != r.deposit.year ||
+            strcmp(b->country, r.country) != 0 || b->phone != r.phone ||
+            memcmp(&b->amount, &r.amount, sizeof(double)) != 0 ||
+            strncmp(b->accountType, r.accountType, sizeof(b->accountType) - 1) != 0)
+        {
+            if (errors++ < 10)
+                printf("record %d differs: id %d amount %.17g\n", count, r.id, r.amount);
+        }
+        count++;
+    }
+    fclose(fp);
+    free(loaded.records);
+
+    if (count != loaded.count)
+    {
+        printf("getAccountFromFile read %d records, the bulk loader %d\n", count, loaded.count);
+        errors++;
+    }
+    printf("%d records, %s\n", count, errors ? "MISMATCH" : "identical");
+    printf("getAccountFromFile %10.2f ms\n", scanned * 1e3);
+    printf("bulk loader        %10.2f ms (%.1fx)\n", bulk * 1e3, scanned / bulk);
+    return errors != 0;
+}
+
+/**
+ * @brief Compare the interest table with a scalar loop over the records
+ */
+static int benchInterest(int records)
+{
+    struct LoadedRecords loaded;
+    struct InterestTable table;
+    float *scalar;
+    int rounds = 10;
+    int errors = 0;
+
+    generate(records / 10 + 1, records);
+    loadRecords();
+    if ((loaded.records = malloc(records * sizeof(struct Record))) == NULL ||
+        (scalar = malloc(records * sizeof(float))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    loaded.count = 0;
+    listAllAccounts(keepRecord, &loaded);
+
+    // the way checkDetails works, one account at a time
+    double start = now();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int i = 0; i < loaded.count; i++)
+        {
+            const struct Record *r = &loaded.records[i];
+            scalar[r->accountNbr] = accountInterest(accountTypeCode(r->accountType), r->amount);
+        }
+    }
+    double scalarTime = (now() - start) / rounds;
+
+    start = now();
+    buildInterestTable(&table);
+    double buildTime = now() - start;
+
+    start = now();
+    for (int round = 0; round < rounds; round++)
+    {
+        projectInterest(&table);
+    }
+    double tableTime = (now() - start) / rounds;
+
+    for (int i = 0; i < table.count; i++)
+    {
+        if (memcmp(&table.interest[i], &scalar[table.accountNbr[i]], sizeof(float)) != 0 && errors++ < 10)
+            printf("account %d differs: %.9g and %.9g\n", table.accountNbr[i], table.interest[i], scalar[table.accountNbr[i]]);
+    }
+
+    printf("%d accounts, %s\n", table.count, errors ? "MISMATCH" : "identical");
+    printf("%-22s %14s %12s\n", "projection", "accounts/sec", "ms");
+    printf("%-22s %14.0f %12.2f\n", "scalar loop", loaded.count / scalarTime, scalarTime * 1e3);
+    printf("%-22s %14.0f %12.2f\n", "interest table", table.count / tableTime, tableTime * 1e3);
+    printf("%-22s %14.0f %12.2f\n", "table snapshot", table.count / buildTime, buildTime * 1e3);
+    freeInterestTable(&table);
+    free(loaded.records);
+    free(scalar);
+    return errors != 0;
+}
+
+/**
+ * @brief Compare a cold start from the text files with one from a snapshot
+ */
+static void benchStartup(int records)
+{
+    generate(records / 10 + 1, records);
+    setLogSync(0);
+
+    double start = now();
+    loadRecords();
+    loadUsers();
+    double text = now() - start;
+
+    start = now();
+    checkpointRecords();
+    double blocked = now() - start;
+    waitSnapshot();
+    double written = now() - start;
+
+    start = now();
+    loadRecords();
+    loadUsers();
+    double snapshot = now() - start;
+
+    printf("%d records, %d users\n", records, records / 10 + 1);
+    printf("%-28s %10.2f ms\n", "start from the text files", text * 1e3);
+    printf("%-28s %10.2f ms\n", "start from the snapshot", snapshot * 1e3);
+    printf("%-28s %10.2f ms\n", "snapshot, store locked", blocked * 1e3);
+    printf("%-28s %10.2f ms\n", "snapshot, until on disk", written * 1e3);
+}
+
+/**
+ * @brief Time loading and rewriting a book split into more and more shards
+ * @return 0 if every layout holds every account
+ */
+static int benchShards(int records, int maxShards)
+{
+    int errors = 0;
+
+    generate(records / 10 + 1, records);
+    setLogSync(0);
+
+    printf("%d records, %d cores\n", records, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %14s %14s\n", "shards", "load ms", "rewrite ms");
+    for (int shards = 1; shards <= maxShards && shards <= MAX_SHARDS; shards *= 2)
+    {
+        int count = 0;
+
+        reshardRecords(shards);
+        double start = now();
+        loadRecords();
+        double load = now() - start;
+        start = now();
+        saveRecords();
+        double rewrite = now() - start;
+
+        forEachAccount(countRecord, &count);
+        if (count != records)
+        {
+            printf("%d shards hold %d accounts instead of %d\n", shards, count, records);
+            errors++;
+        }
+        printf("%8d %14.2f %14.2f\n", shards, load * 1e3, rewrite * 1e3);
+    }
+    return errors != 0;
+}
+
+/**
+ * @brief Add the balance of an account, in cents, to a sum
+ */
+static void sumCents(const struct Record *r, void *arg)
+{
+    *(long long *)arg += (long long)(r->amount * 100 + (r->amount < 0 ? -0.5 : 0.5));
+}
+
+/**
+ * @brief Time the aggregate report on more and more threads
+ * @return 0 if every report equals the single-threaded one and its total is right
+ */
+static int benchReport(int records, int maxThreads)
+{
+    char *expected = NULL;
+    size_t expectedSize = 0;
+    long long cents = 0;
+    int errors = 0;
+
+    generate(records / 10 + 1, records);
+    setLogSync(0);
+    loadRecords();
+    listAllAccounts(sumCents, &cents);
+
+    printf("%d records, %d cores\n", records, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %14s %16s\n", "threads", "ms", "accounts/sec");
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        char *text;
+        size_t size;
+        FILE *out = open_memstream(&text, &size);
+
+        double start = now();
+        writeReport(out, REPORT_TOP_OWNERS, threads);
+        double elapsed = now() - start;
+        fclose(out);
+
+        if (expected == NULL)
+        {
+            char line[128];
+            snprintf(line, sizeof(line), "bank accounts=%d total=%lld.%02lld\n", records, cents / 100, cents % 100);
+            if (strncmp(text, line, strlen(line)) != 0)
+            {
+                printf("report starts with %.60s, expected %s", text, line);
+                errors++;
+            }
+            expected = text;
+            expectedSize = size;
+        }
+        else
+        {
+            if (size != expectedSize || memcmp(text, expected, size) != 0)
+            {
+                printf("the report of %d threads differs from the single-threaded one\n", threads);
+                errors++;
+            }
+            free(text);
+        }
+        printf("%8d %14.2f %16.0f\n", threads, elapsed * 1e3, records / elapsed);
+    }
+    free(expected);
+    return errors != 0;
+}
+
+/**
+ * @brief Get the resident set size of the process in bytes
+ */
+static long long residentBytes(void)
+{
+    long long pages = 0;
+    long long resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+
+    if (fp != NULL)
+    {
+        if (fscanf(fp, "%lld %lld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(fp);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief Count the records of the records file the store does not hold as they were written
+ */
+static void checkStored(const struct Record *r, void *arg)
+{
+    struct Record stored;
+
+    if (!findAccount(r->accountNbr, &stored) || stored.id != r->id || stored.userId != r->userId ||
+        strcmp(stored.name, r->name) != 0 || strcmp(stored.country, r->country) != 0 ||
+        strcmp(stored.accountType, r->accountType) != 0 || stored.phone != r->phone ||
+        stored.amount != r->amount || stored.deposit.year != r->deposit.year ||
+        stored.deposit.month != r->deposit.month || stored.deposit.day != r->deposit.day)
+        (*(int *)arg)++;
+}
+
+/**
+ * @brief Give an account a country no other account had, dropping unused strings when due
+ */
+static void renameCountry(const struct Record *r, void *arg)
+{
+    struct Record renamed = *r;
+
+    snprintf(renamed.country, sizeof(renamed.country), "c%d", (*(int *)arg)++);
+    updateAccount(&renamed);
+    if (internRebuildDue())
+        reclaimStrings();
+}
+
+/**
+ * @brief Give an account back the country it was generated with, dropping unused strings when due
+ */
+static void restoreCountry(const struct Record *r, void *arg)
+{
+    (void)arg;
+    updateAccount(r);
+    if (internRebuildDue())
+        reclaimStrings();
+}
+
+/**
+ * @brief Measure the memory the store takes per account
+ * @return 0 if every account reads back as it was written
+ */
+static int benchMemory(int records)
+{
+    unsigned int strings;
+    int errors = 0;
+
+    generate(records / 10 + 1, records);
+    setLogSync(0);
+
+    long long before = residentBytes();
+    loadRecords();
+    long long resident = residentBytes() - before;
+    size_t store = storeMemory();
+    size_t pools = internMemory(&strings);
+
+    loadRecordFile(RECORDS, checkStored, &errors);
+    checkpointRecords();
+    waitSnapshot();
+    loadRecords();
+    loadRecordFile(RECORDS, checkStored, &errors);
+
+    // countries nobody uses any more must not pile up in the pools
+    int renamed = 0;
+    unsigned int left;
+    for (int pass = 0; pass < 3; pass++)
+    {
+        loadRecordFile(RECORDS, renameCountry, &renamed);
+    }
+    loadRecordFile(RECORDS, restoreCountry, NULL);
+    reclaimStrings();
+    internMemory(&left);
+    loadRecordFile(RECORDS, checkStored, &errors);
+    if (left != strings)
+    {
+        printf("%u interned strings left after renaming every country, %u before\n", left, strings);
+        errors++;
+    }
+    if (errors != 0)
+        printf("%d accounts do not read back as they were written\n", errors);
+
+    // the indexes are the same with either layout, only the slots differ
+    size_t wide = store - pools + (size_t)records * (sizeof(struct Record) - sizeof(struct Slot));
+    printf("%d records, %u interned strings\n", records, strings);
+    printf("%-28s %10zu bytes\n", "struct Record", sizeof(struct Record));
+    printf("%-28s %10zu bytes\n", "struct Slot", sizeof(struct Slot));
+    printf("%-28s %10.1f bytes/account\n", "store, struct Record slots", (double)wide / records);
+    printf("%-28s %10.1f bytes/account\n", "store, struct Slot slots", (double)store / records);
+    printf("%-28s %10.1f bytes/account\n", "  of which string pools", (double)pools / records);
+    printf("%-28s %10.1f bytes/account\n", "resident set growth", (double)resident / records);
+    return errors != 0;
+}
+
+/**
+ * @brief Open a number of saving accounts for the benchmark user
+ */
+static void createAccounts(int count)
+{
+    struct Record r = {0};
+
+    strcpy(benchUser.name, "bench");
+    strcpy(benchUser.password, "bench");
+    if (!findUser(benchUser.name, NULL))
+        registerNewUser(&benchUser);
+    else
+        loginUser(&benchUser);
+
+    for (int i = 0; i < count; i++)
+    {
+        r.accountNbr = i;
+        r.deposit.month = 1;
+        r.deposit.day = 1;
+        r.deposit.year = 2025;
+        strcpy(r.country, "Bench");
+        r.phone = 1;
+        r.amount = 100;
+        strcpy(r.accountType, "saving");
+        openAccount(benchUser, &r);
+    }
+}
+
+/**
+ * @brief Work of one deposit thread
+ */
+struct DepositWork
+{
+    int accounts;       ///< Accounts to spread over, 1 for the hot account
+    int ops;            ///< Deposits to run
+    unsigned int seed;  ///< Random seed of the thread
+};
+
+/**
+ * @brief Deposit thread: run the deposits of its work
+ */
+static void *depositWorker(void *arg)
+{
+    struct DepositWork *work = arg;
+
+    for (int i = 0; i < work->ops; i++)
+    {
+        int account = work->accounts > 1 ? rand_r(&work->seed) % work->accounts : 0;
+        transact(benchUser, account, 1.0, NULL);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Time deposits run by a number of threads
+ * @return Deposits per second
+ */
+static double runDeposits(int threads, int accounts, int ops)
+{
+    pthread_t tid[threads];
+    struct DepositWork work[threads];
+    double start = now();
+
+    for (int i = 0; i < threads; i++)
+    {
+        work[i].accounts = accounts;
+        work[i].ops = ops;
+        work[i].seed = i + 1;
+        pthread_create(&tid[i], NULL, depositWorker, &work[i]);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tid[i], NULL);
+    }
+    return (double)threads * ops / (now() - start);
+}
+
+/**
+ * @brief Print the scaling curve of deposits with the striped account locks
+ */
+static void benchLocks(int maxThreads, int accounts)
+{
+    loadRecords();
+    loadUsers();
+    setLogSync(0);
+    setCheckpointInterval(1 << 30);
+    createAccounts(accounts);
+
+    printf("deposits/sec, %d accounts, %d cores\n", accounts, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %16s %16s\n", "threads", "spread", "hot account");
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double spread = runDeposits(threads, accounts, BENCH_OPS_PER_THREAD);
+        double hot = runDeposits(threads, 1, BENCH_OPS_PER_THREAD);
+        printf("%8d %16.0f %16.0f\n", threads, spread, hot);
+    }
+}
+
+/**
+ * @brief Work of one move thread
+ */
+struct MoveWork
+{
+    int accounts;       ///< Accounts to move money between
+    int ops;            ///< Moves to try
+    int native;         ///< 1 to use moveFunds, 0 for a withdrawal and a deposit
+    int moved;          ///< Moves that went through
+    unsigned int seed;  ///< Random seed of the thread
+};
+
+/**
+ * @brief Move thread: move 1 between random pairs of accounts
+ */
+static void *moveWorker(void *arg)
+{
+    struct MoveWork *work = arg;
+
+    for (int i = 0; i < work->ops; i++)
+    {
+        int from = rand_r(&work->seed) % work->accounts;
+        int to = rand_r(&work->seed) % (work->accounts - 1);
+        to += to >= from;
+        if (work->native)
+        {
+            work->moved += moveFunds(benchUser, from, to, 1.0, NULL) == OP_OK;
+        }
+        else if (transact(benchUser, from, -1.0, NULL) == OP_OK)
+        {
+            transact(benchUser, to, 1.0, NULL);
+            work->moved++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Time moves run by a number of threads
+ *
+ * @param moved Receives the number of moves that went through
+ * @return Moves per second
+ */
+static double runMoves(int threads, int accounts, int ops, int native, int *moved)
+{
+    pthread_t tid[threads];
+    struct MoveWork work[threads];
+    double start = now();
+
+    *moved = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        work[i].accounts = accounts;
+        work[i].ops = ops;
+        work[i].native = native;
+        work[i].moved = 0;
+        work[i].seed = i + 1;
+        pthread_create(&tid[i], NULL, moveWorker, &work[i]);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tid[i], NULL);
+        *moved += work[i].moved;
+    }
+    return *moved / (now() - start);
+}
+
+/**
+ * @brief Compare durable moves with MOVE and as two transactions
+ * @return 0 if every move took one log entry and the money adds up
+ */
+static int benchMoves(int maxThreads, int accounts, int ops)
+{
+    long long cents = 0;
+    int errors = 0;
+
+    loadRecords();
+    loadUsers();
+    setCheckpointInterval(1 << 30);
+    createAccounts(accounts);
+
+    printf("durable moves/sec, %d accounts, %d cores\n", accounts, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %16s %16s\n", "threads", "move", "two transacts");
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        int moved;
+        int entries = logSize();
+        double native = runMoves(threads, accounts, ops, 1, &moved);
+        if (logSize() - entries != moved)
+        {
+            printf("%d moves took %d log entries\n", moved, logSize() - entries);
+            errors++;
+        }
+        double split = runMoves(threads, accounts, ops, 0, &moved);
+        printf("%8d %16.0f %16.0f\n", threads, native, split);
+    }
+
+    listAllAccounts(sumCents, &cents);
+    if (cents != (long long)accounts * 10000)
+    {
+        printf("the accounts hold %lld cents instead of %lld\n", cents, (long long)accounts * 10000);
+        errors++;
+    }
+    return errors != 0;
+}
+
+/**
+ * @brief Compare giving accounts to another user one by one with giving
+ * them all at once
+ * @return 0 if each way moved every account, the bulk one in one log entry,
+ *         and the owners survive a reload
+ */
+static int benchGive(int accounts)
+{
+    struct User heir;
+    int given = 0;
+    int owned = 0;
+    int errors = 0;
+
+    loadRecords();
+    loadUsers();
+    setCheckpointInterval(1 << 30);
+    createAccounts(accounts);
+    strcpy(heir.name, "heir");
+    strcpy(heir.password, "heir");
+    registerNewUser(&heir);
+
+    int entries = logSize();
+    double start = now();
+    for (int i = 0; i < accounts; i++)
+    {
+        if (giveAccount(benchUser, i, heir.name) == OP_OK)
+            given++;
+    }
+    double single = now() - start;
+    listAccounts(heir, countRecord, &owned);
+    if (given != accounts || owned != accounts || logSize() - entries != accounts)
+    {
+        printf("giving one by one moved %d of %d accounts in %d log entries\n", owned, accounts, logSize() - entries);
+        errors++;
+    }
+
+    entries = logSize();
+    start = now();
+    giveAllAccounts(heir, benchUser.name, NULL, &given);
+    double bulk = now() - start;
+    owned = 0;
+    listAccounts(benchUser, countRecord, &owned);
+    if (given != accounts || owned != accounts || logSize() - entries != 1)
+    {
+        printf("giving all moved %d of %d accounts in %d log entries\n", owned, accounts, logSize() - entries);
+        errors++;
+    }
+
+    loadRecords();
+    owned = 0;
+    listAccounts(benchUser, countRecord, &owned);
+    if (owned != accounts)
+    {
+        printf("after a reload the owner has %d of %d accounts\n", owned, accounts);
+        errors++;
+    }
+
+    printf("durable transfer of %d accounts\n", accounts);
+    printf("%-20s %12.3f ms\n", "one by one", single * 1000);
+    printf("%-20s %12.3f ms\n", "all at once", bulk * 1000);
+    return errors != 0;
+}
+
+/**
+ * @brief Work of one thread of the mixed load
+ */
+struct MixedWork
+{
+    int ops;            ///< Operations to run
+    unsigned int seed;  ///< Random seed of the thread
+    double *reads;      ///< Latency of every read
+    double *writes;     ///< Latency of every durable deposit
+    int readCount;
+    int writeCount;
+};
+
+/**
+ * @brief Mixed load thread: four balance checks for each durable deposit
+ */
+static void *mixedWorker(void *arg)
+{
+    struct MixedWork *work = arg;
+    struct Record r;
+
+    for (int i = 0; i < work->ops; i++)
+    {
+        int account = rand_r(&work->seed) % 10000;
+        double start = now();
+        if (rand_r(&work->seed) % 5 == 0)
+        {
+            transact(benchUser, account, 1.0, NULL);
+            work->writes[work->writeCount++] = now() - start;
+        }
+        else
+        {
+            getAccount(benchUser, account, &r);
+            work->reads[work->readCount++] = now() - start;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Run the mixed load on a number of threads and print its latencies
+ */
+static void runMixed(const char *backend, int threads, int ops)
+{
+    pthread_t tid[threads];
+    struct MixedWork work[threads];
+    double *reads = malloc((size_t)threads * ops * sizeof(double));
+    double *writes = malloc((size_t)threads * ops * sizeof(double));
+    int readCount = 0;
+    int writeCount = 0;
+    char name[32];
+
+    for (int i = 0; i < threads; i++)
+    {
+        work[i].ops = ops;
+        work[i].seed = i + 1;
+        work[i].reads = reads + (size_t)i * ops;
+        work[i].writes = writes + (size_t)i * ops;
+        work[i].readCount = 0;
+        work[i].writeCount = 0;
+        pthread_create(&tid[i], NULL, mixedWorker, &work[i]);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(tid[i], NULL);
+        memmove(reads + readCount, work[i].reads, work[i].readCount * sizeof(double));
+        memmove(writes + writeCount, work[i].writes, work[i].writeCount * sizeof(double));
+        readCount += work[i].readCount;
+        writeCount += work[i].writeCount;
+    }
+    snprintf(name, sizeof(name), "%s read", backend);
+    report(name, reads, readCount);
+    snprintf(name, sizeof(name), "%s write", backend);
+    report(name, writes, writeCount);
+    free(reads);
+    free(writes);
+}
+
+/**
+ * @brief Compare the read and durable write latencies of the log backends under a mixed load
+ */
+static void benchMixed(int threads, int ops)
+{
+    loadRecords();
+    loadUsers();
+    setLogSync(0);
+    setCheckpointInterval(1 << 30);
+    createAccounts(10000);
+    setLogSync(1);
+
+    printf("%d threads, %d ops each, 80%% reads\n", threads, ops);
+    printf("%-22s %10s %14s %12s %12s\n", "operation", "calls", "ops/sec", "p50 us", "p99 us");
+    setLogBackend(0);
+    runMixed("pwrite", threads, ops);
+    if (setLogBackend(1))
+        runMixed("io_uring", threads, ops);
+    else
+        printf("io_uring is not available\n");
+}
+
+/**
+ * @brief Compare durable deposits under group commit with deposits that are never synced
+ */
+static void benchCommit(int maxThreads, int ops)
+{
+    loadRecords();
+    loadUsers();
+    setLogSync(0);
+    setCheckpointInterval(1 << 30);
+    createAccounts(10000);
+
+    printf("deposits/sec, %d per thread\n", ops);
+    printf("%8s %16s %16s %16s\n", "threads", "not durable", "no window", "group commit");
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        setLogSync(0);
+        double fast = runDeposits(threads, 10000, ops);
+        setLogSync(1);
+        setGroupCommit(1, 0);
+        double unbatched = runDeposits(threads, 10000, ops);
+        setGroupCommit(GROUP_COMMIT_ENTRIES, GROUP_COMMIT_USEC);
+        double grouped = runDeposits(threads, 10000, ops);
+        printf("%8d %16.0f %16.0f %16.0f\n", threads, fast, unbatched, grouped);
+    }
+}
+
+/**
+ * @brief Check the statistics percentiles and time the cost of recording
+ * @return 0 if every percentile is within the histogram precision
+ */
+static int benchStats(int ops)
+{
+    static const double fractions[] = {0.5, 0.9, 0.99, 0.999};
+    double reported[4];
+    double steps[4001];
+    double *latencies;
+    unsigned int seed = 7;
+    int errors = 0;
+
+    if ((latencies = malloc(ops * sizeof(double))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+
+    // latencies spread evenly on a log scale from 10 us to 100 ms
+    steps[0] = 10000;
+    for (int i = 1; i < 4001; i++)
+    {
+        steps[i] = steps[i - 1] * 1.00230524;
+    }
+    resetStats();
+    for (int i = 0; i < ops; i++)
+    {
+        long long nanos = steps[rand_r(&seed) % 4001];
+        statsEnd(STAT_CHECK, statsNow() - nanos, OP_OK);
+        latencies[i] = nanos / 1e3;
+    }
+    qsort(latencies, ops, sizeof(double), compareLatency);
+
+    char *lines = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&lines, &length);
+    writeStats(out);
+    fclose(out);
+    char *check = strstr(lines, "\ncheck ");
+    if (check == NULL || sscanf(check, "\ncheck %*s %*s %*s p50=%lf p90=%lf p99=%lf p999=%lf",
+                                &reported[0], &reported[1], &reported[2], &reported[3]) != 4)
+    {
+        printf("unexpected statistics:\n%s", lines);
+        return 1;
+    }
+    free(lines);
+
+    printf("%-8s %14s %14s %10s\n", "", "exact (us)", "reported (us)", "error");
+    for (int i = 0; i < 4; i++)
+    {
+        double exact = latencies[(int)(fractions[i] * (ops - 1))];
+        double error = (reported[i] - exact) / exact;
+        printf("p%-7g %14.1f %14.1f %9.2f%%\n", fractions[i] * 100, exact, reported[i], error * 100);
+        // a bucket spans 1/16 of its start
+        if (error > 1.0 / 16 || error < -1.0 / 16)
+            errors++;
+    }
+    free(latencies);
+
+    loadRecords();
+    loadUsers();
+    setLogSync(0);
+    setCheckpointInterval(1 << 30);
+    createAccounts(1000);
+    resetStats();
+
+    double start = now();
+    for (int i = 0; i < ops; i++)
+    {
+        statsEnd(STAT_CHECK, statsBegin(STAT_CHECK), OP_OK);
+    }
+    double recording = (now() - start) / ops;
+    unsigned int depositSeed = 1;
+    start = now();
+    for (int i = 0; i < ops; i++)
+    {
+        transact(benchUser, rand_r(&depositSeed) % 1000, 1.0, NULL);
+    }
+    double deposit = (now() - start) / ops;
+    printf("\nrecording one operation %8.1f ns\n", recording * 1e9);
+    printf("one deposit, recorded  %8.1f ns (%.1f%% spent recording)\n\n", deposit * 1e9, recording / deposit * 100);
+    writeStats(stdout);
+    return errors != 0;
+}
+
+/**
+ * @brief Work of one login thread
+ */
+struct LoginWork
+{
+    int users;          ///< Users to log in as, named pw<n>
+    int logins;         ///< Logins to run
+    unsigned int seed;  ///< Random seed of the thread
+    int failed;         ///< Logins refused
+};
+
+/**
+ * @brief Login thread: log random users in
+ */
+static void *loginWorker(void *arg)
+{
+    struct LoginWork *work = arg;
+    struct User u;
+
+    for (int i = 0; i < work->logins; i++)
+    {
+        int n = rand_r(&work->seed) % work->users;
+        sprintf(u.name, "pw%d", n);
+        sprintf(u.password, "secret%d", n);
+        work->failed += loginUser(&u) != OP_OK;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Check the password hash and print the logins/sec at each cost
+ * @return 0 if the hash matches the known vectors and every login succeeded
+ */
+static int benchPassword(int threads, int logins)
+{
+    static const struct
+    {
+        const char *password;
+        const char *salt;
+        unsigned long iterations;
+        const char *key;
+    } vectors[] = {
+        {"password", "salt", 1, "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b"},
+        {"password", "salt", 4096, "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a"},
+        {"passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096,
+         "348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1c635518c7dac47e9"},
+    };
+    int errors = 0;
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        unsigned char key[40];
+        char hex[81];
+        size_t length = strlen(vectors[i].key) / 2;
+
+        pbkdf2Sha256(vectors[i].password, (const unsigned char *)vectors[i].salt, strlen(vectors[i].salt),
+                     vectors[i].iterations, key, length);
+        for (size_t j = 0; j < length; j++)
+        {
+            sprintf(hex + j * 2, "%02x", key[j]);
+        }
+        if (strcmp(hex, vectors[i].key) != 0)
+        {
+            printf("PBKDF2 vector %zu: got %s, expected %s\n", i, hex, vectors[i].key);
+            errors++;
+        }
+    }
+    printf("PBKDF2-HMAC-SHA256 vectors %s\n", errors ? "FAILED" : "ok");
+
+    loadRecords();
+    loadUsers();
+    printf("logins/sec, %d sessions, %d cores\n", threads, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%6s %12s %14s\n", "cost", "iterations", "logins/sec");
+    for (int cost = 8; cost <= 16; cost += 2)
+    {
+        pthread_t tid[threads];
+        struct LoginWork work[threads];
+        struct User u;
+
+        // a fresh set of users per cost, hashed at that cost
+        setPasswordCost(cost);
+        for (int n = 0; n < 64; n++)
+        {
+            sprintf(u.name, "pw%d", n);
+            sprintf(u.password, "secret%d", n);
+            if (loginUser(&u) != OP_OK && registerNewUser(&u) != OP_OK)
+                errors++;
+        }
+
+        int count = logins >> (cost - 8);
+        double start = now();
+        for (int i = 0; i < threads; i++)
+        {
+            work[i].users = 64;
+            work[i].logins = count / threads + 1;
+            work[i].seed = i + 1;
+            work[i].failed = 0;
+            pthread_create(&tid[i], NULL, loginWorker, &work[i]);
+        }
+        for (int i = 0; i < threads; i++)
+        {
+            pthread_join(tid[i], NULL);
+            errors += work[i].failed;
+        }
+        double elapsed = now() - start;
+        printf("%6d %12lu %14.0f\n", cost, 1UL << cost, threads * (count / threads + 1) / elapsed);
+    }
+    return errors != 0;
+}
+
+/**
+ * @brief Print how to call the benchmarks
+ */
+static int usage(const char *name)
+{
+    printf("Usage: %s generate <users> <records> [directory]\n", name);
+    printf("       %s run <records> [users] [ops] [--sync]\n", name);
+    printf("       %s parse <records>\n", name);
+    printf("       %s interest <records>\n", name);
+    printf("       %s commit [max threads] [deposits per thread]\n", name);
+    printf("       %s startup <records>\n", name);
+    printf("       %s stats [ops]\n", name);
+    printf("       %s password [threads] [logins per cost]\n", name);
+    printf("       %s locks [max threads] [accounts]\n", name);
+    printf("       %s moves [max threads] [accounts] [moves per thread]\n", name);
+    printf("       %s give [accounts]\n", name);
+    printf("       %s mixed [threads] [ops per thread]\n", name);
+    printf("       %s shards <records> [max shards]\n", name);
+    printf("       %s report <records> [max threads]\n", name);
+    printf("       %s memory <records>\n", name);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return usage(argv[0]);
+
+    if (strcmp(argv[1], "generate") == 0 && argc > 3)
+    {
+        if (argc > 4 && chdir(argv[4]) != 0)
+        {
+            perror(argv[4]);
+            return 1;
+        }
+        initSystem();
+        generate(atoi(argv[2]), atoi(argv[3]));
+    }
+    else if (strcmp(argv[1], "run") == 0 && argc > 2)
+    {
+        int sync = strcmp(argv[argc - 1], "--sync") == 0;
+        int args = argc - sync;
+        int records = atoi(argv[2]);
+
+        if (records < 4)
+            return usage(argv[0]);
+        openScratch();
+        benchRun(records, args > 3 ? atoi(argv[3]) : records / 10 + 1, args > 4 ? atoi(argv[4]) : BENCH_DEFAULT_OPS, sync);
+    }
+    else if (strcmp(argv[1], "parse") == 0 && argc > 2)
+    {
+        openScratch();
+        return benchParser(atoi(argv[2]));
+    }
+    else if (strcmp(argv[1], "interest") == 0 && argc > 2)
+    {
+        openScratch();
+        return benchInterest(atoi(argv[2]));
+    }
+    else if (strcmp(argv[1], "commit") == 0)
+    {
+        openScratch();
+        benchCommit(argc > 2 ? atoi(argv[2]) : 64, argc > 3 ? atoi(argv[3]) : 500);
+    }
+    else if (strcmp(argv[1], "startup") == 0 && argc > 2)
+    {
+        openScratch();
+        benchStartup(atoi(argv[2]));
+    }
+    else if (strcmp(argv[1], "stats") == 0)
+    {
+        openScratch();
+        return benchStats(argc > 2 ? atoi(argv[2]) : 100000);
+    }
+    else if (strcmp(argv[1], "password") == 0)
+    {
+        openScratch();
+        return benchPassword(argc > 2 ? atoi(argv[2]) : 32, argc > 3 ? atoi(argv[3]) : 4000);
+    }
+    else if (strcmp(argv[1], "locks") == 0)
+    {
+        openScratch();
+        benchLocks(argc > 2 ? atoi(argv[2]) : 16, argc > 3 ? atoi(argv[3]) : 10000);
+    }
+    else if (strcmp(argv[1], "moves") == 0)
+    {
+        int accounts = argc > 3 ? atoi(argv[3]) : 16;
+
+        if (accounts < 2)
+            return usage(argv[0]);
+        openScratch();
+        return benchMoves(argc > 2 ? atoi(argv[2]) : 16, accounts, argc > 4 ? atoi(argv[4]) : 500);
+    }
+    else if (strcmp(argv[1], "give") == 0)
+    {
+        openScratch();
+        return benchGive(argc > 2 ? atoi(argv[2]) : 1000);
+    }
+    else if (strcmp(argv[1], "mixed") == 0)
+    {
+        openScratch();
+        benchMixed(argc > 2 ? atoi(argv[2]) : 16, argc > 3 ? atoi(argv[3]) : 2000);
+    }
+    else if (strcmp(argv[1], "shards") == 0 && argc > 2)
+    {
+        openScratch();
+        return benchShards(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 16);
+    }
+    else if (strcmp(argv[1], "report") == 0 && argc > 2)
+    {
+        openScratch();
+        return benchReport(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 16);
+    }
+    else if (strcmp(argv[1], "memory") == 0 && argc > 2)
+    {
+        openScratch();
+        return benchMemory(atoi(argv[2]));
+    }
+    else
+    {
+        return usage(argv[0]);
+    }
+    return 0;
+}
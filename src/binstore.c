@@ -0,0 +1,220 @@
+/**
+ * @file binstore.c
+ * @brief Memory-mapped binary record store for the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * The binary store is an optional replacement for the text records file.
+ * It holds a header followed by fixed-size slots laid out exactly as
+ * struct Record, and is mapped into memory so the account store uses the
+ * slots directly: startup parses nothing and a change is written in place.
+ *
+ * The store is used whenever BINARY_RECORDS exists. Run `atm --to-binary`
+ * to create it from the text files and `atm --to-text` to go back.
+ */
+
+#include "header.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char *BINARY_RECORDS = "./data/records.bin";
+
+#define BINARY_MAGIC "ATMR"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_SIZE 64   ///< Header size, keeps the slots aligned
+
+/**
+ * @brief Header at the start of the binary store
+ */
+struct BinaryHeader
+{
+    char magic[4];      ///< Always BINARY_MAGIC
+    int version;        ///< Format version, BINARY_VERSION
+    int recordSize;     ///< sizeof(struct Record) of the writer
+    int count;          ///< Number of used slots
+    int capacity;       ///< Number of slots the file has room for
+};
+
+static int binaryFd = -1;           ///< Descriptor of the mapped file
+static char *mapping;               ///< Start of the mapping
+static size_t mappingSize;          ///< Size of the mapping in bytes
+
+/**
+ * @brief Get the header of the mapped store
+ */
+static struct BinaryHeader *binaryHeader(void)
+{
+    return (struct BinaryHeader *)mapping;
+}
+
+/**
+ * @brief Map the whole file, sized for a number of slots
+ */
+static void mapBinaryStore(int capacity)
+{
+    mappingSize = BINARY_HEADER_SIZE + (size_t)capacity * sizeof(struct Record);
+    if (ftruncate(binaryFd, mappingSize) != 0)
+    {
+        printf("Error! resizing file");
+        exit(1);
+    }
+    mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, binaryFd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        printf("Error! mapping file");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Check whether the binary store is in use
+ */
+int binaryStoreExists(void)
+{
+    struct stat st;
+    return stat(BINARY_RECORDS, &st) == 0;
+}
+
+/**
+ * @brief Map the binary store
+ *
+ * @param count Receives the number of used slots
+ * @param capacity Receives the number of slots available
+ * @return The first slot of the mapping
+ */
+struct Record *openBinaryStore(int *count, int *capacity)
+{
+    struct stat st;
+
+    if ((binaryFd = open(BINARY_RECORDS, O_RDWR)) == -1 || fstat(binaryFd, &st) != 0)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    if ((size_t)st.st_size < BINARY_HEADER_SIZE)
+    {
+        printf("Error! %s is not a record store", BINARY_RECORDS);
+        exit(1);
+    }
+
+    mappingSize = st.st_size;
+    mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, binaryFd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        printf("Error! mapping file");
+        exit(1);
+    }
+
+    struct BinaryHeader *h = binaryHeader();
+    if (memcmp(h->magic, BINARY_MAGIC, 4) != 0 || h->version != BINARY_VERSION ||
+        h->recordSize != (int)sizeof(struct Record) ||
+        mappingSize < BINARY_HEADER_SIZE + (size_t)h->capacity * sizeof(struct Record))
+    {
+        printf("Error! %s is not a record store of this version", BINARY_RECORDS);
+        exit(1);
+    }
+
+    *count = h->count;
+    *capacity = h->capacity;
+    return (struct Record *)(mapping + BINARY_HEADER_SIZE);
+}
+
+/**
+ * @brief Grow the file so it has room for more slots
+ *
+ * The mapping may move, so any slot pointer taken before is invalid.
+ *
+ * @param capacity New number of slots
+ * @return The first slot of the new mapping
+ */
+struct Record *growBinaryStore(int capacity)
+{
+    munmap(mapping, mappingSize);
+    mapBinaryStore(capacity);
+    binaryHeader()->capacity = capacity;
+    return (struct Record *)(mapping + BINARY_HEADER_SIZE);
+}
+
+/**
+ * @brief Flush a byte range of the mapping to disk
+ */
+static void syncRange(size_t offset, size_t length)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t start = offset - offset % page;
+
+    if (msync(mapping + start, offset + length - start, MS_SYNC) != 0)
+    {
+        printf("Error! writing file");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Make changed bytes of the store durable
+ *
+ * @param data Start of the changed bytes, inside the slots
+ * @param length Number of changed bytes
+ * @param count Number of used slots to record in the header
+ */
+void syncBinaryStore(const void *data, size_t length, int count)
+{
+    struct BinaryHeader *h = binaryHeader();
+
+    if (length > 0)
+        syncRange((const char *)data - mapping, length);
+    if (h->count != count)
+    {
+        h->count = count;
+        syncRange(0, sizeof(struct BinaryHeader));
+    }
+}
+
+/**
+ * @brief Write a new binary store holding the given records
+ */
+void createBinaryStore(const struct Record *r, int count)
+{
+    struct BinaryHeader *h;
+    int capacity = 64;
+
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+    if ((binaryFd = open(BINARY_RECORDS, O_RDWR | O_CREAT | O_TRUNC, 0600)) == -1)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    mapBinaryStore(capacity);
+
+    h = binaryHeader();
+    memcpy(h->magic, BINARY_MAGIC, 4);
+    h->version = BINARY_VERSION;
+    h->recordSize = sizeof(struct Record);
+    h->count = count;
+    h->capacity = capacity;
+    memcpy(mapping + BINARY_HEADER_SIZE, r, (size_t)count * sizeof(struct Record));
+
+    if (msync(mapping, mappingSize, MS_SYNC) != 0)
+    {
+        printf("Error! writing file");
+        exit(1);
+    }
+    closeBinaryStore();
+}
+
+/**
+ * @brief Unmap the binary store
+ */
+void closeBinaryStore(void)
+{
+    if (binaryFd == -1)
+        return;
+    munmap(mapping, mappingSize);
+    close(binaryFd);
+    binaryFd = -1;
+}
@@ -17,6 +17,119 @@
 #define MAX_PASSWORD_SIZE 50
 #define MAX_COUNTRY_SIZE 100
 #define MAX_TRANSACTION_TYPE_SIZE 10
+#define LOG_CHECKPOINT_ENTRIES 1024   ///< Log entries written before the records file is rebuilt
+#define SERVER_WORKERS 8              ///< Default number of server worker threads
+#define MAX_CONNECTIONS 1024          ///< Most sessions the server holds at once
+#define REQUEST_SIZE 1024             ///< Longest protocol request line
+#define LOCK_STRIPES 64               ///< Number of account lock stripes
+#define MAX_SHARDS 64                 ///< Most shards the account store is split into
+#define REPORT_TOP_OWNERS 10          ///< Owners listed by default in a report
+#define LOG_ENTRY_SIZE 512            ///< Longest transaction log entry
+#define LOG_BUFFER_SIZE 65536         ///< Initial size of the log buffers
+#define GROUP_COMMIT_ENTRIES 64       ///< Pending log entries that end a group commit window
+#define GROUP_COMMIT_USEC 200         ///< Longest group commit window in microseconds
+#define MAX_ROTATED_LOGS 1024        ///< Most rotated logs replayed at startup
+#define COMPACT_MIN_DEAD 64           ///< Fewest tombstones worth a compaction
+#define DEAD_RECORD -1                ///< Record id marking the tombstone of a deleted account
+#define PASSWORD_COST 12              ///< Default log2 of the PBKDF2 iterations of a password hash
+#define PASSWORD_MIN_COST 4           ///< Lowest accepted password hash cost
+#define PASSWORD_MAX_COST 24          ///< Highest accepted password hash cost
+#define PASSWORD_QUEUE 256            ///< Password checks queued at most for the hashing pool
+
+/**
+ * @brief Result codes of the account operations
+ */
+enum OpResult
+{
+    OP_OK,              ///< The operation succeeded
+    OP_NO_ACCOUNT,      ///< The user has no account with that number
+    OP_ACCOUNT_TAKEN,   ///< The account number is already used
+    OP_FIXED_ACCOUNT,   ///< Fixed accounts do not accept transactions
+    OP_NO_FUNDS,        ///< The balance does not cover the withdrawal
+    OP_NO_USER,         ///< The user does not exist
+    OP_USER_TAKEN,      ///< The user name is already registered
+    OP_BAD_LOGIN,       ///< Wrong user name or password
+    OP_INVALID          ///< The request or its values are invalid
+};
+
+/**
+ * @brief Kinds of ids handed out by the id counters
+ */
+enum IdKind
+{
+    ID_USER,            ///< User ids
+    ID_RECORD,          ///< Record ids
+    ID_KINDS            ///< Number of id kinds
+};
+
+/**
+ * @brief Operations timed by the operation statistics
+ */
+enum StatOp
+{
+    STAT_CREATE,        ///< openAccount
+    STAT_UPDATE,        ///< changeAccountInfo
+    STAT_CHECK,         ///< getAccount
+    STAT_LIST,          ///< listAccounts
+    STAT_TRANSACT,      ///< transact
+    STAT_REMOVE,        ///< closeAccount
+    STAT_TRANSFER,      ///< giveAccount
+    STAT_MOVE,          ///< moveFunds
+    STAT_TRANSFER_ALL,  ///< giveAllAccounts
+    STAT_LOGIN,         ///< loginUser
+    STAT_REGISTER,      ///< registerNewUser
+    STAT_CHECKPOINT,    ///< Checkpoints and compactions run by the operations
+    STAT_OPS            ///< Number of timed operations
+};
+
+/**
+ * @brief String pools of the account store
+ */
+enum InternPool
+{
+    POOL_NAMES,         ///< Owner names
+    POOL_COUNTRIES,     ///< Countries
+    POOL_TYPES,         ///< Account types
+    INTERN_POOLS        ///< Number of pools
+};
+
+/**
+ * @brief Account type codes
+ */
+enum AccountTypeCode
+{
+    TYPE_SAVING,        ///< "saving", monthly interest
+    TYPE_CURRENT,       ///< "current", no interest
+    TYPE_FIXED01,       ///< "fixed01", interest after one year
+    TYPE_FIXED02,       ///< "fixed02", interest after two years
+    TYPE_FIXED03,       ///< "fixed03", interest after three years
+    TYPE_UNKNOWN,       ///< Any other type, treated as current
+    ACCOUNT_TYPES       ///< Number of type codes
+};
+
+/**
+ * @brief When an account type pays its interest
+ */
+enum Payout
+{
+    PAYOUT_NONE,        ///< Never
+    PAYOUT_MONTHLY,     ///< Every month, on the day of the deposit
+    PAYOUT_AT_TERM      ///< Once, when the term ends
+};
+
+/**
+ * @brief Behavior of an account type, one entry per type code in accountTypes
+ */
+struct AccountType
+{
+    const char *name;   ///< Account type as stored in the records
+    const char *label;  ///< Note shown next to the name when opening an account
+    double rate;        ///< Rate applied to the balance
+    double years;       ///< Years the rate is paid for, the term of a fixed account
+    double months;      ///< Months the yearly amount is split over
+    int payout;         ///< When the interest is paid, a Payout
+    int transactable;   ///< 1 if the account takes deposits and withdrawals
+};
 
 /**
  * @brief Structure to store date information
@@ -39,12 +152,35 @@ struct Record
     char country[MAX_COUNTRY_SIZE]; ///< Country of residence
     int phone;                      ///< Phone number
     char accountType[MAX_TRANSACTION_TYPE_SIZE]; ///< Type of account (savings/current/fixed)
+    unsigned char type;             ///< Type code of accountType, set by the account store
     int accountNbr;                 ///< Account number
     double amount;                  ///< Current balance
     struct Date deposit;            ///< Date of account creation
     struct Date withdraw;           ///< Date of last withdrawal
 };
 
+/**
+ * @brief Compact form of a record kept by the account store
+ *
+ * The owner name, country and account type are ids of interned strings and
+ * the deposit date is packed. The withdraw date, which no file keeps, is
+ * dropped.
+ */
+struct Slot
+{
+    int id;                         ///< Unique record identifier, DEAD_RECORD for a tombstone
+    int userId;                     ///< ID of the user who owns this record
+    int accountNbr;                 ///< Account number
+    int phone;                      ///< Phone number
+    double amount;                  ///< Current balance
+    unsigned int name;              ///< Username of the account owner, in POOL_NAMES
+    unsigned int country;           ///< Country of residence, in POOL_COUNTRIES
+    int year;                       ///< Date of account creation
+    unsigned char month;
+    unsigned char day;
+    unsigned short type;            ///< Type code, TYPE_UNKNOWN + the POOL_TYPES id for an unknown type
+};
+
 /**
  * @brief Structure to store user information
  */
@@ -55,6 +191,27 @@ struct User
     char password[MAX_PASSWORD_SIZE]; ///< User's password
 };
 
+/**
+ * @brief Balances of every account grouped by account type
+ */
+struct InterestTable
+{
+    int count;                      ///< Number of accounts
+    int start[ACCOUNT_TYPES + 1];   ///< Accounts of type t are at positions start[t] to start[t + 1] - 1
+    int *accountNbr;                ///< Account numbers
+    double *balance;                ///< Balances
+    float *interest;                ///< Projected interest, filled by projectInterest
+};
+
+/**
+ * @brief Structure to store the state of a protocol session
+ */
+struct Session
+{
+    int loggedIn;                   ///< 1 once LOGIN or REGISTER succeeded
+    struct User user;               ///< Logged in user
+};
+
 // authentication functions
 void loginMenu(char a[MAX_USERNAME_SIZE], char pass[MAX_PASSWORD_SIZE]);
 // utility functions
@@ -65,10 +222,19 @@ void registerUser(char a[MAX_USERNAME_SIZE],  char pass[MAX_PASSWORD_SIZE]);
 const char *getUserName(struct User u);
 void saveUser(struct User *u);
 int getUser(FILE *ptr, struct User *u);
+void loadUsers(void);
+int findUser(const char *name, struct User *u);
+int loginUser(struct User *u);
+int registerNewUser(struct User *u);
+int migratePasswords(void);
+void lockUsers(void);
+void unlockUsers(void);
+const struct User *userTable(int *count, long long *bytes);
 
 // system function
 void createNewAcc(struct User u);
 void mainMenu(struct User u);
+void initMenu(struct User *u);
 void checkAllAccounts(struct User u);
 void updateInfo(struct User u);
 void removeAccount(struct User u);
@@ -79,6 +245,7 @@ void transferOwner(struct User u);
 //utility
 void toLowerCase(char *str);
 void clearStdin();
+void clearScreen(void);
 int checkValidDate(const struct Date *date);
 int checkValidAccount(const char *accountType);
 void checkBuffer(char initial[100]);
@@ -87,4 +254,149 @@ int isLeapYear(int year);
 int getAccountFromFile(FILE *ptr, struct Record *r);
 void saveAccountToFile(FILE *ptr, const struct Record *r);
 void stayOrReturn(int notGood, const char *message, void (*retryFunc)(struct User), struct User u);
-void success(struct User u);
\ No newline at end of file
+void success(struct User u);
+void initSystem();
+
+// account store
+void loadRecords(void);
+int shardOf(int accountNbr);
+int storeShards(void);
+void runOnShards(void (*fn)(int shard, void *arg), void *arg);
+void saveRecords(void);
+void checkpointRecords(void);
+int checkpointDue(void);
+void reclaimStrings(void);
+void setCheckpointInterval(int entries);
+int compactionDue(int shard);
+void compactRecords(int shard);
+void convertRecords(int toBinary);
+void reshardRecords(int count);
+int findAccount(int accountNbr, struct Record *r);
+int findUserAccount(struct User u, int accountNbr, struct Record *r);
+void forEachUserAccount(struct User u, void (*fn)(const struct Record *, void *), void *arg);
+int shardSlots(int shard);
+void forEachAccountInSlots(int shard, int from, int to, void (*fn)(const struct Record *, void *), void *arg);
+void forEachShardAccount(int shard, void (*fn)(const struct Record *, void *), void *arg);
+void forEachAccount(void (*fn)(const struct Record *, void *), void *arg);
+int insertAccount(const struct Record *r);
+int updateAccount(const struct Record *r);
+int updateBalance(int accountNbr, double amount);
+int moveBalance(int fromNbr, double fromAmount, int toNbr, double toAmount);
+int reassignAccounts(int fromId, const char *fromName, int toId, const char *toName, const char *accountType);
+int deleteAccount(int accountNbr);
+size_t storeMemory(void);
+
+// string pools
+unsigned int intern(int pool, const char *s);
+int internFind(int pool, const char *s, unsigned int *id);
+const char *internString(int pool, unsigned int id);
+const char *internBlock(int pool, int block, size_t *used);
+void internLoad(int pool, const char *bytes, size_t length);
+void internReset(void);
+void internSettle(void);
+int internRebuildDue(void);
+void internRebuildBegin(void);
+unsigned int internRemap(int pool, unsigned int id);
+void internRebuildEnd(void);
+size_t internMemory(unsigned int *strings);
+
+// transaction log
+void openLog(int entries, long end, int generation);
+int rotatedLogs(int *generations, int max);
+FILE *openRotatedLog(int generation);
+void removeRotatedLogs(int generation);
+int rotateLog(void);
+int getLogEntry(FILE *ptr, char *op, struct Record *r, struct Record *to, int **accounts);
+void appendLog(char op, const struct Record *r);
+void appendMove(int fromNbr, double fromAmount, int toNbr, double toAmount);
+void appendReassign(int toId, const char *toName, const int *accounts, int count);
+void syncLog(void);
+void setGroupCommit(int entries, int micros);
+int logSize(void);
+void setLogSync(int sync);
+void truncateLog(void);
+void flushLog(void);
+int setLogBackend(int useUring);
+
+// io_uring
+struct Uring;
+struct Uring *uringSetup(void);
+void uringClose(struct Uring *u);
+int uringWrite(struct Uring *u, int fd, const void *data, size_t length, long long offset, int sync);
+
+// binary record store
+int binaryStoreExists(void);
+struct Record *openBinaryStore(int *count, int *capacity);
+struct Record *growBinaryStore(int capacity);
+void syncBinaryStore(const void *data, size_t length, int count);
+void createBinaryStore(const struct Record *r, int count);
+void closeBinaryStore(void);
+
+// id counters
+void reserveId(int kind, int id);
+int allocateId(int kind);
+
+// account types and interest projection
+extern const struct AccountType accountTypes[ACCOUNT_TYPES];
+int accountTypeCode(const char *accountType);
+float accountInterest(int type, double amount);
+void buildInterestTable(struct InterestTable *t);
+void projectInterest(struct InterestTable *t);
+void freeInterestTable(struct InterestTable *t);
+
+// snapshots
+void startSnapshot(const struct Slot *const *slots, const int *counts, int shards, int generation);
+int snapshotRunning(void);
+void waitSnapshot(void);
+int readSnapshotRecords(struct Slot **slots, int *counts, int shards, int *generation);
+void releaseSnapshotRecords(void);
+struct User *readSnapshotUsers(int *count, long long *usersBytes);
+void removeSnapshot(void);
+
+// operation statistics
+long long statsNow(void);
+long long statsBegin(int op);
+void statsEnd(int op, long long start, int result);
+void statsRead(long bytes);
+void statsWritten(long bytes);
+int writeStats(FILE *out);
+void saveStats(void);
+void resetStats(void);
+
+// password hashing
+void pbkdf2Sha256(const char *password, const unsigned char *salt, size_t saltLength,
+                  unsigned long iterations, unsigned char *out, size_t outLength);
+int passwordHashed(const char *stored, int *cost);
+void hashPassword(const char *password, char *stored);
+void hashPasswords(const char **passwords, char **stored, int count);
+int checkPassword(const char *password, const char *stored);
+int passwordOutdated(const char *stored);
+void setPasswordCost(int cost);
+
+// reports
+void writeReport(FILE *out, int top, int threads);
+
+// bulk loader
+int loadRecordFile(const char *path, void (*fn)(const struct Record *, void *), void *arg);
+
+// account operations
+const char *opMessage(int result);
+int openAccount(struct User u, struct Record *r);
+int accountTaken(int accountNbr);
+int getAccount(struct User u, int accountNbr, struct Record *r);
+void listAccounts(struct User u, void (*fn)(const struct Record *, void *), void *arg);
+void listShardAccounts(int shard, void (*fn)(const struct Record *, void *), void *arg);
+void listAllAccounts(void (*fn)(const struct Record *, void *), void *arg);
+void readAllAccounts(void (*fn)(void *), void *arg);
+int changeAccountInfo(struct User u, int accountNbr, int phone, const char *country);
+int transact(struct User u, int accountNbr, double amount, double *balance);
+int moveFunds(struct User u, int fromNbr, int toNbr, double amount, double *balance);
+int closeAccount(struct User u, int accountNbr, struct Record *removed);
+int giveAccount(struct User u, int accountNbr, const char *username);
+int giveAllAccounts(struct User u, const char *username, const char *accountType, int *given);
+
+// server
+int handleRequest(struct Session *s, char *line, FILE *out);
+void runServer(const char *path, int workers);
+int runClient(const char *path);
+int runHeadless(void);
\ No newline at end of file
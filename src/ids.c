@@ -0,0 +1,110 @@
+/**
+ * @file ids.c
+ * @brief Persistent id counters of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * The next user id and the next record id live in IDS_FILE, so a new id
+ * costs neither a count of the users file nor a scan of the records, and
+ * an id is never handed out twice, even after deletions.
+ *
+ * Ids are leased in blocks of ID_BLOCK: the file records the end of the
+ * current block and is rewritten (temp file, fsync, rename) only when a
+ * block runs out. A crash loses at most the rest of a block, which leaves
+ * a gap in the ids but never a duplicate. When the file is missing, the
+ * counters start after the largest ids found by loadRecords and loadUsers.
+ */
+
+#include "header.h"
+#include <pthread.h>
+#include <unistd.h>
+
+const char *IDS_FILE = "./data/ids.txt";
+
+#define ID_BLOCK 64     ///< Ids leased per write of the ids file
+
+static int nextIds[ID_KINDS];   ///< Next id to hand out of each kind
+static int leasedIds[ID_KINDS]; ///< First id past the leased block of each kind
+static int idsLoaded;
+static pthread_mutex_t idsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Read the ids file once, assumes the ids lock is held
+ */
+static void loadIds(void)
+{
+    FILE *fp;
+
+    if (idsLoaded)
+        return;
+    idsLoaded = 1;
+    if ((fp = fopen(IDS_FILE, "r")) == NULL)
+        return;
+    if (fscanf(fp, "%d %d", &leasedIds[ID_USER], &leasedIds[ID_RECORD]) != 2)
+        leasedIds[ID_USER] = leasedIds[ID_RECORD] = 0;
+    fclose(fp);
+
+    // ids before the end of the last lease may have been handed out
+    nextIds[ID_USER] = leasedIds[ID_USER];
+    nextIds[ID_RECORD] = leasedIds[ID_RECORD];
+}
+
+/**
+ * @brief Write the leases to the ids file atomically, assumes the ids lock is held
+ */
+static void saveIds(void)
+{
+    FILE *temp;
+
+    if ((temp = fopen("./data/ids.tmp", "w")) == NULL)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    fprintf(temp, "%d %d\n", leasedIds[ID_USER], leasedIds[ID_RECORD]);
+    if (fflush(temp) != 0 || fsync(fileno(temp)) != 0)
+    {
+        printf("Error! writing file");
+        exit(1);
+    }
+    fclose(temp);
+    rename("./data/ids.tmp", IDS_FILE);
+}
+
+/**
+ * @brief Make sure the counter of a kind is past an id already in use
+ *
+ * Called by the loaders with the largest id they found, so the counters
+ * stay correct if the ids file is lost or older than the data.
+ *
+ * @param kind ID_USER or ID_RECORD
+ * @param id Id in use
+ */
+void reserveId(int kind, int id)
+{
+    pthread_mutex_lock(&idsLock);
+    loadIds();
+    if (nextIds[kind] <= id)
+        nextIds[kind] = id + 1;
+    pthread_mutex_unlock(&idsLock);
+}
+
+/**
+ * @brief Hand out a new id
+ *
+ * @param kind ID_USER or ID_RECORD
+ * @return An id never handed out before
+ */
+int allocateId(int kind)
+{
+    pthread_mutex_lock(&idsLock);
+    loadIds();
+    int id = nextIds[kind]++;
+    if (nextIds[kind] > leasedIds[kind])
+    {
+        leasedIds[kind] = id + ID_BLOCK;
+        saveIds();
+    }
+    pthread_mutex_unlock(&idsLock);
+    return id;
+}
@@ -0,0 +1,405 @@
+/**
+ * @file intern.c
+ * @brief String pools of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * The account store keeps every distinct owner name, country and account
+ * type once, in a pool, and refers to it by a small id given in the order
+ * the strings were first seen. A pool keeps its strings back to back in
+ * blocks that never move, so a string is read by id without any lock: the
+ * id a reader finds in a record was published, under the locks of the
+ * record, after the string was. Adding a string takes the lock of its pool.
+ *
+ * The string of each id is found through a short table of chunks, each
+ * twice the size of the one before, allocated as the pool grows. A small
+ * pool thus costs a few kilobytes, and no chunk ever moves.
+ *
+ * Snapshots save the blocks as they are, the strings in id order, and
+ * loading them back gives every string its old id.
+ *
+ * A string stays in its pool after the last account using it changes, so
+ * once a pool has grown to twice its size at the last rebuild, the store
+ * rebuilds every pool from the strings its live slots use, with the whole
+ * book locked; see internRebuildBegin.
+ */
+
+#include "header.h"
+#include <pthread.h>
+
+#define INTERN_BLOCK (1 << 20)      ///< Largest string block, the first ones are smaller
+#define INTERN_MAX_BLOCKS 4096      ///< Most string blocks of a pool
+#define INTERN_CHUNK_BITS 8         ///< log2 of the ids of the first chunk of the id table
+#define INTERN_CHUNKS (32 - INTERN_CHUNK_BITS + 1) ///< Chunks needed for every 32-bit id
+#define INTERN_REBUILD_MIN 1024     ///< Strings a pool gains past twice its size before a rebuild
+
+/**
+ * @brief One string pool
+ */
+struct Pool
+{
+    pthread_mutex_t lock;
+    unsigned int count;                     ///< Strings in the pool
+    const char **ids[INTERN_CHUNKS];        ///< Chunks of the string of each id, chunk k holds 2^k times the first
+    char *blocks[INTERN_MAX_BLOCKS];        ///< String blocks
+    size_t blockSize[INTERN_MAX_BLOCKS];    ///< Bytes allocated for each block
+    size_t blockUsed[INTERN_MAX_BLOCKS];    ///< Bytes used in each block
+    int blockCount;
+    unsigned int *table;                    ///< Open addressing table of id + 1, 0 when empty
+    unsigned int tableCapacity;             ///< Always a power of two
+};
+
+static struct Pool pools[INTERN_POOLS] = {
+    [POOL_NAMES] = {.lock = PTHREAD_MUTEX_INITIALIZER},
+    [POOL_COUNTRIES] = {.lock = PTHREAD_MUTEX_INITIALIZER},
+    [POOL_TYPES] = {.lock = PTHREAD_MUTEX_INITIALIZER},
+};
+
+static struct Pool retired[INTERN_POOLS];       ///< Pools being rebuilt from, their locks are never taken
+static unsigned int *remap[INTERN_POOLS];       ///< New id + 1 of each retired id, 0 until remapped
+static unsigned int rebuiltCount[INTERN_POOLS]; ///< Strings in each pool after the last load or rebuild
+
+/**
+ * @brief Hash a string with FNV-1a
+ */
+static unsigned int hashString(const char *s)
+{
+    unsigned int h = 2166136261u;
+    while (*s)
+    {
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Get the chunk of an id and its position in the chunk
+ */
+static unsigned int chunkOf(unsigned int id, unsigned int *offset)
+{
+    unsigned int chunk = 31 - __builtin_clz((id >> INTERN_CHUNK_BITS) + 1);
+    *offset = id - (((1u << chunk) - 1) << INTERN_CHUNK_BITS);
+    return chunk;
+}
+
+/**
+ * @brief Get the string of an id in a pool
+ */
+static const char *poolString(const struct Pool *p, unsigned int id)
+{
+    unsigned int offset;
+    unsigned int chunk = chunkOf(id, &offset);
+    return p->ids[chunk][offset];
+}
+
+/**
+ * @brief Get the string of an id, assumes the id is in the pool
+ */
+const char *internString(int pool, unsigned int id)
+{
+    return poolString(&pools[pool], id);
+}
+
+/**
+ * @brief Find the table position of a string, or the empty one it would take
+ */
+static unsigned int tableFind(const struct Pool *p, const char *s)
+{
+    unsigned int i = hashString(s) & (p->tableCapacity - 1);
+    while (p->table[i] != 0 && strcmp(poolString(p, p->table[i] - 1), s) != 0)
+    {
+        i = (i + 1) & (p->tableCapacity - 1);
+    }
+    return i;
+}
+
+/**
+ * @brief Double the table of a pool and put every id back
+ */
+static void growTable(struct Pool *p)
+{
+    unsigned int *old = p->table;
+    unsigned int oldCapacity = p->tableCapacity;
+
+    p->tableCapacity = p->tableCapacity ? p->tableCapacity * 2 : 64;
+    if ((p->table = calloc(p->tableCapacity, sizeof(unsigned int))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < oldCapacity; i++)
+    {
+        if (old[i] != 0)
+            p->table[tableFind(p, poolString(p, old[i] - 1))] = old[i];
+    }
+    free(old);
+}
+
+/**
+ * @brief Copy a string into the blocks of a pool
+ * @return The copy
+ */
+static const char *storeString(struct Pool *p, const char *s)
+{
+    size_t length = strlen(s) + 1;
+    int b = p->blockCount - 1;
+
+    if (b < 0 || p->blockUsed[b] + length > p->blockSize[b])
+    {
+        b = p->blockCount;
+        size_t size = b < 8 ? (size_t)4096 << b : INTERN_BLOCK;
+        if (b == INTERN_MAX_BLOCKS || (p->blocks[b] = malloc(size)) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+        p->blockSize[b] = size;
+        p->blockUsed[b] = 0;
+        p->blockCount++;
+    }
+    char *copy = p->blocks[b] + p->blockUsed[b];
+    memcpy(copy, s, length);
+    p->blockUsed[b] += length;
+    return copy;
+}
+
+/**
+ * @brief Get the id of a string, adding it to the pool if it is new
+ *
+ * @param pool POOL_* pool
+ * @param s String, at most INTERN_BLOCK bytes
+ * @return Id of the string
+ */
+unsigned int intern(int pool, const char *s)
+{
+    struct Pool *p = &pools[pool];
+
+    pthread_mutex_lock(&p->lock);
+    if ((p->count + 1) * 2 > p->tableCapacity)
+        growTable(p);
+    unsigned int i = tableFind(p, s);
+    if (p->table[i] == 0)
+    {
+        unsigned int offset;
+        unsigned int c = chunkOf(p->count, &offset);
+        const char **chunk = p->ids[c];
+        if (chunk == NULL)
+        {
+            if ((chunk = malloc(((size_t)1 << (c + INTERN_CHUNK_BITS)) * sizeof(const char *))) == NULL)
+            {
+                printf("Error! out of memory");
+                exit(1);
+            }
+            p->ids[c] = chunk;
+        }
+        chunk[offset] = storeString(p, s);
+        p->table[i] = p->count + 1;
+        p->count++;
+    }
+    unsigned int id = p->table[i] - 1;
+    pthread_mutex_unlock(&p->lock);
+    return id;
+}
+
+/**
+ * @brief Find the id of a string without adding it
+ *
+ * @param id Receives the id
+ * @return 1 if the string is in the pool, 0 otherwise
+ */
+int internFind(int pool, const char *s, unsigned int *id)
+{
+    struct Pool *p = &pools[pool];
+    int found = 0;
+
+    pthread_mutex_lock(&p->lock);
+    if (p->tableCapacity > 0)
+    {
+        unsigned int i = tableFind(p, s);
+        found = p->table[i] != 0;
+        if (found)
+            *id = p->table[i] - 1;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return found;
+}
+
+/**
+ * @brief Get a string block of a pool, without locking or allocating
+ *
+ * The blocks hold the strings in id order, each followed by its NUL.
+ *
+ * @param block Block number, from 0
+ * @param used Receives the bytes used in the block
+ * @return The block, NULL past the last one
+ */
+const char *internBlock(int pool, int block, size_t *used)
+{
+    const struct Pool *p = &pools[pool];
+
+    if (block >= p->blockCount)
+        return NULL;
+    *used = p->blockUsed[block];
+    return p->blocks[block];
+}
+
+/**
+ * @brief Refill an empty pool from the bytes of its blocks, giving every string its old id
+ */
+void internLoad(int pool, const char *bytes, size_t length)
+{
+    const char *end = bytes + length;
+
+    while (bytes < end)
+    {
+        intern(pool, bytes);
+        bytes += strlen(bytes) + 1;
+    }
+}
+
+/**
+ * @brief Forget the strings of a pool without freeing them
+ */
+static void clearPool(struct Pool *p)
+{
+    for (int c = 0; c < INTERN_CHUNKS; c++)
+    {
+        p->ids[c] = NULL;
+    }
+    p->table = NULL;
+    p->tableCapacity = 0;
+    p->blockCount = 0;
+    p->count = 0;
+}
+
+/**
+ * @brief Free the strings of a pool and empty it
+ */
+static void freePool(struct Pool *p)
+{
+    for (int b = 0; b < p->blockCount; b++)
+    {
+        free(p->blocks[b]);
+    }
+    for (int c = 0; c < INTERN_CHUNKS; c++)
+    {
+        free(p->ids[c]);
+    }
+    free(p->table);
+    clearPool(p);
+}
+
+/**
+ * @brief Empty every pool, only while no id is in use
+ */
+void internReset(void)
+{
+    for (int pool = 0; pool < INTERN_POOLS; pool++)
+    {
+        freePool(&pools[pool]);
+        rebuiltCount[pool] = 0;
+    }
+}
+
+/**
+ * @brief Take the size of every pool as the one internRebuildDue compares against
+ */
+void internSettle(void)
+{
+    for (int pool = 0; pool < INTERN_POOLS; pool++)
+    {
+        rebuiltCount[pool] = pools[pool].count;
+    }
+}
+
+/**
+ * @brief Check whether a pool has grown enough since the last rebuild to rebuild them
+ */
+int internRebuildDue(void)
+{
+    for (int pool = 0; pool < INTERN_POOLS; pool++)
+    {
+        unsigned int count = __atomic_load_n(&pools[pool].count, __ATOMIC_RELAXED);
+        if (count >= rebuiltCount[pool] * 2 + INTERN_REBUILD_MIN)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Start rebuilding every pool from the ids still in use
+ *
+ * The pools are emptied and their strings kept aside; the caller passes
+ * every id in use through internRemap and stores the new id in its place,
+ * then calls internRebuildEnd to free the strings no one asked for. No
+ * other thread may hold or look up an id until then.
+ */
+void internRebuildBegin(void)
+{
+    for (int pool = 0; pool < INTERN_POOLS; pool++)
+    {
+        struct Pool *p = &pools[pool];
+        retired[pool] = *p;
+        clearPool(p);
+        if ((remap[pool] = calloc(retired[pool].count + 1, sizeof(unsigned int))) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+    }
+}
+
+/**
+ * @brief Get the new id of an id from before internRebuildBegin
+ */
+unsigned int internRemap(int pool, unsigned int id)
+{
+    if (remap[pool][id] == 0)
+        remap[pool][id] = intern(pool, poolString(&retired[pool], id)) + 1;
+    return remap[pool][id] - 1;
+}
+
+/**
+ * @brief Free the strings no id was remapped to, ending the rebuild
+ */
+void internRebuildEnd(void)
+{
+    for (int pool = 0; pool < INTERN_POOLS; pool++)
+    {
+        freePool(&retired[pool]);
+        free(remap[pool]);
+        remap[pool] = NULL;
+    }
+    internSettle();
+}
+
+/**
+ * @brief Get the bytes allocated by every pool
+ *
+ * @param strings Receives the number of strings in all pools, may be NULL
+ */
+size_t internMemory(unsigned int *strings)
+{
+    size_t bytes = 0;
+    unsigned int count = 0;
+
+    for (int pool = 0; pool < INTERN_POOLS; pool++)
+    {
+        struct Pool *p = &pools[pool];
+        pthread_mutex_lock(&p->lock);
+        for (int b = 0; b < p->blockCount; b++)
+        {
+            bytes += p->blockSize[b];
+        }
+        for (int c = 0; c < INTERN_CHUNKS && p->ids[c] != NULL; c++)
+        {
+            bytes += ((size_t)1 << (c + INTERN_CHUNK_BITS)) * sizeof(const char *);
+        }
+        bytes += (size_t)p->tableCapacity * sizeof(unsigned int);
+        count += p->count;
+        pthread_mutex_unlock(&p->lock);
+    }
+    if (strings != NULL)
+        *strings = count;
+    return bytes;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file loader.c
+ * @brief Bulk loader of the records file for the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * getAccountFromFile reads one record with an eleven-conversion fscanf,
+ * which dominates the load of a large records file. The bulk loader maps
+ * the whole file and parses the fields straight from the mapping, giving
+ * exactly the records getAccountFromFile would read:
+ *
+ *   - fields are separated by any whitespace and numbers may be signed,
+ *   - the date is three numbers separated by '/',
+ *   - strings longer than their field are cut to fit,
+ *   - parsing stops at the first record that does not match.
+ *
+ * Balances with at most 15 digits and 22 decimals are exact in a double
+ * before the final division, so the division rounds them exactly like
+ * strtod; any other number is handed to strtod.
+ */
+
+#include "header.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const double powersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+ * @brief Cursor over the mapped file
+ */
+struct Cursor
+{
+    const char *pos;    ///< Next byte to parse
+    const char *end;    ///< End of the file
+};
+
+/**
+ * @brief Check whether a byte is whitespace for scanf
+ */
+static int isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * @brief Skip the whitespace before a field
+ */
+static void skipSpace(struct Cursor *c)
+{
+    while (c->pos < c->end && isSpace(*c->pos))
+    {
+        c->pos++;
+    }
+}
+
+/**
+ * @brief Parse an integer field like %d
+ * @return 1 if an integer was read
+ */
+static int parseInt(struct Cursor *c, int *value)
+{
+    int negative = 0;
+    unsigned int n = 0;
+
+    skipSpace(c);
+    if (c->pos < c->end && (*c->pos == '-' || *c->pos == '+'))
+        negative = *c->pos++ == '-';
+    if (c->pos == c->end || *c->pos < '0' || *c->pos > '9')
+        return 0;
+    while (c->pos < c->end && *c->pos >= '0' && *c->pos <= '9')
+    {
+        n = n * 10 + (*c->pos++ - '0');
+    }
+    *value = negative ? (int)-n : (int)n;
+    return 1;
+}
+
+/**
+ * @brief Parse a string field like %s, cut to the size of the field
+ * @return 1 if a string was read
+ */
+static int parseString(struct Cursor *c, char *value, size_t size)
+{
+    size_t length = 0;
+
+    skipSpace(c);
+    const char *start = c->pos;
+    while (c->pos < c->end && !isSpace(*c->pos))
+    {
+        c->pos++;
+    }
+    if (c->pos == start)
+        return 0;
+    length = c->pos - start;
+    if (length >= size)
+        length = size - 1;
+    memcpy(value, start, length);
+    value[length] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Parse a balance field like %lf
+ * @return 1 if a number was read
+ */
+static int parseDouble(struct Cursor *c, double *value)
+{
+    const char *p;
+    unsigned long long digits = 0;
+    int count = 0;
+    int decimals = 0;
+    int negative = 0;
+
+    skipSpace(c);
+    p = c->pos;
+    if (p < c->end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    for (; p < c->end && *p >= '0' && *p <= '9'; p++, count++)
+    {
+        digits = digits * 10 + (*p - '0');
+    }
+    if (p < c->end && *p == '.')
+    {
+        for (p++; p < c->end && *p >= '0' && *p <= '9'; p++, count++, decimals++)
+        {
+            digits = digits * 10 + (*p - '0');
+        }
+    }
+
+    if (count > 0 && count <= 15 && (p == c->end || isSpace(*p)))
+    {
+        *value = decimals ? (double)digits / powersOfTen[decimals] : (double)digits;
+        if (negative)
+            *value = -*value;
+        c->pos = p;
+        return 1;
+    }
+
+    // exponents, hex, inf, nan and long numbers: copy the token for strtod
+    char token[64];
+    char *stop;
+    size_t length = 0;
+    while (c->pos + length < c->end && !isSpace(c->pos[length]) && length < sizeof(token) - 1)
+    {
+        token[length] = c->pos[length];
+        length++;
+    }
+    token[length] = '\0';
+    *value = strtod(token, &stop);
+    if (stop == token)
+        return 0;
+    c->pos += stop - token;
+    return 1;
+}
+
+/**
+ * @brief Match a literal character like the '/' of the date
+ */
+static int parseChar(struct Cursor *c, char expected)
+{
+    if (c->pos == c->end || *c->pos != expected)
+        return 0;
+    c->pos++;
+    return 1;
+}
+
+/**
+ * @brief Parse one record in the records file format
+ * @return 1 if a complete record was read
+ */
+static int parseRecord(struct Cursor *c, struct Record *r)
+{
+    return parseInt(c, &r->id) &&
+           parseInt(c, &r->userId) &&
+           parseString(c, r->name, sizeof(r->name)) &&
+           parseInt(c, &r->accountNbr) &&
+           parseInt(c, &r->deposit.month) && parseChar(c, '/') &&
+           parseInt(c, &r->deposit.day) && parseChar(c, '/') &&
+           parseInt(c, &r->deposit.year) &&
+           parseString(c, r->country, sizeof(r->country)) &&
+           parseInt(c, &r->phone) &&
+           parseDouble(c, &r->amount) &&
+           parseString(c, r->accountType, sizeof(r->accountType));
+}
+
+/**
+ * @brief Parse every record of a records file
+ *
+ * @param path Path of the records file
+ * @param fn Function called with every record read
+ * @param arg Argument passed to fn
+ * @return Number of records read, -1 if the file cannot be opened
+ */
+int loadRecordFile(const char *path, void (*fn)(const struct Record *, void *), void *arg)
+{
+    struct stat st;
+    struct Record r;
+    struct Cursor c;
+    char *data;
+    int count = 0;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return -1;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    if ((data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    c.pos = data;
+    c.end = data + st.st_size;
+    memset(&r, 0, sizeof(r));
+    while (parseRecord(&c, &r))
+    {
+        fn(&r, arg);
+        count++;
+    }
+    munmap(data, st.st_size);
+    return count;
+}
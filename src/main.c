@@ -4,152 +4,110 @@
  * @author Khalid Hussein
  * @date 2025
  * 
- * This file contains the main entry point and core menu functions for the
- * ATM Management System. It handles user interaction and navigation through
- * the system's various features.
+ * This file contains the main entry point of the ATM Management System.
+ * It starts the terminal menus or one of the maintenance and server
+ * commands.
  */
 
 #include "header.h"
 
+extern const char *SOCKET_PATH;
+
 /**
- * @brief Display and handle the main menu options
+ * @brief Main function to initialize the ATM Management System
  * 
- * This function displays the main menu of the ATM system and handles user
- * input for various operations like creating accounts, making transactions,
- * and managing account information.
+ * This function initializes the user structure and calls the main menu function
+ * to start the ATM Management System. The operation statistics of a
+ * terminal session are written to STATS_FILE when it exits.
+ *
+ * Commands:
+ *   --to-binary                  convert the text records into the binary record store
+ *   --to-text                    convert the binary record store back into the text records
+ *   --reshard <n>                split the records into n shards, each with its own file
+ *   --report [top] [threads]     print the totals by country, account type and top owners
+ *   --server [socket] [workers]  serve many sessions over a Unix domain socket
+ *   --client [socket]            talk to a running server from the terminal
+ *   --headless                   serve the protocol on the standard input and output
+ *   --hash-passwords             hash every password still stored in plaintext
  *
- * @param u User structure containing the current user's information
+ * Any of them, or the terminal menus, may be preceded by the options
+ * --password-cost <n>, the cost of new password hashes as the log2 of
+ * their iterations, and --io-uring, to write the transaction log through
+ * io_uring where the kernel allows it.
+ *
+ * Every command but --client locks ./data for its process, so only one
+ * atm process uses the store at a time.
+ *
+ * @return int Exit status of the program
  */
-void mainMenu(struct User u)
+int main(int argc, char *argv[])
 {
-begin:
-    int option;
-    system("clear");
-    printf("\n\n\t\t======= ATM =======\n\n");
-    printf("\n\t\t-->> Feel free to choose one of the options below <<--\n");
-    printf("\n\t\t[1]- Create a new account\n");
-    printf("\n\t\t[2]- Update account information\n");
-    printf("\n\t\t[3]- Check accounts\n");
-    printf("\n\t\t[4]- Check list of owned account\n");
-    printf("\n\t\t[5]- Make Transaction\n");
-    printf("\n\t\t[6]- Remove existing account\n");
-    printf("\n\t\t[7]- Transfer ownership\n");
-    printf("\n\t\t[8]- Exit\n");
-    scanf("%d", &option);
-    getchar();
+    int useUring = 0;
 
-    switch (option)
+    // options come first, each one shifts the command line
+    for (;;)
     {
-    case 1:
-        createNewAcc(u);
-        break;
-    case 2:
-        updateInfo(u);
-        break;
-    case 3:
-        checkDetails(u);
-        break;
-    case 4:
-        checkAllAccounts(u);
-        break;
-    case 5:
-        makeTransaction(u);
-        break;
-    case 6:
-        removeAccount(u);
-        break;
-    case 7:
-        transferOwner(u);
-        break;
-    case 8:
-        exit(1);
-        break;
-    default:
-        goto begin;
-        printf("Invalid operation!\n");
+        if (argc > 2 && strcmp(argv[1], "--password-cost") == 0)
+        {
+            setPasswordCost(atoi(argv[2]));
+            argv[2] = argv[0];
+            argv += 2;
+            argc -= 2;
+        }
+        else if (argc > 1 && strcmp(argv[1], "--io-uring") == 0)
+        {
+            useUring = 1;
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+        }
+        else
+            break;
     }
-};
+    if (useUring && !setLogBackend(1))
+        fprintf(stderr, "io_uring is not available, the log is written with pwrite and fdatasync\n");
 
-/**
- * @brief Initialize the main menu and handle user login or registration
- * 
- * This function displays the initial menu for user login or registration,
- * allowing users to either log in with existing credentials or register a new account.
- *
- * @param u Pointer to a User structure to store user information
- */
-void initMenu(struct User *u)
-{
-    char initial[100];
-    int r = 0;
-    int option;
-    system("clear");
-entry:
-    printf("\n\n\t\t======= ATM =======\n");
-    printf("\n\t\t-->> Feel free to login / register :\n");
-    printf("\n\t\t[1]- login\n");
-    printf("\n\t\t[2]- register\n");
-    printf("\n\t\t[3]- exit\n");
-    while (!r)
+    if (argc > 1)
     {
+        if (strcmp(argv[1], "--client") == 0)
+            return runClient(argc > 2 ? argv[2] : SOCKET_PATH);
 
-        fgets(initial,100,stdin);
-        checkBuffer(initial);
-        if (checkValidType(initial, "int") != 0)
+        initSystem();
+        if (strcmp(argv[1], "--to-binary") == 0)
+            convertRecords(1);
+        else if (strcmp(argv[1], "--to-text") == 0)
+            convertRecords(0);
+        else if (strcmp(argv[1], "--reshard") == 0 && argc > 2)
+            reshardRecords(atoi(argv[2]));
+        else if (strcmp(argv[1], "--report") == 0)
         {
-            printf("\n\t\t✖ Please!! Enter a valid option\n");
-            goto entry;
+            loadRecords();
+            writeReport(stdout, argc > 2 ? atoi(argv[2]) : REPORT_TOP_OWNERS, argc > 3 ? atoi(argv[3]) : 0);
         }
-        sscanf(initial, "%d", &option);
-        switch (option)
+        else if (strcmp(argv[1], "--server") == 0)
+            runServer(argc > 2 ? argv[2] : SOCKET_PATH, argc > 3 ? atoi(argv[3]) : SERVER_WORKERS);
+        else if (strcmp(argv[1], "--headless") == 0)
+            return runHeadless();
+        else if (strcmp(argv[1], "--hash-passwords") == 0)
         {
-        case 1:
-            loginMenu(u->name, u->password);
-            if (strcmp(u->password, getPassword(*u)) == 0)
-            {
-                printf("\n\nPassword Match!");
-                u->id = getId(*u);
-            }
-            else
-            {
-                printf("\nWrong password!! or User Name\n");
-                exit(1);
-            }
-            r = 1;
-            break;
-        case 2:
-            registerUser(u->name, u->password);
-            if (strcmp(u->name, getUserName(*u)) == 0)
-            {
-                printf("\n\nUser name already taken\n");
-                exit(1);
-            }
-            u->id = setId();
-            saveUser(u);
-            r = 1;
-            break;
-        case 3:
-            exit(1);
-            break;
-        default:
-            printf("Insert a valid operation!\n");
+            loadUsers();
+            printf("%d passwords hashed\n", migratePasswords());
+        }
+        else
+        {
+            printf("Usage: %s [--password-cost <n>] [--io-uring] [--to-binary | --to-text | --reshard <n> | --report [top] [threads] | --server [socket] [workers] | --client [socket] | --headless | --hash-passwords]\n", argv[0]);
+            return 1;
         }
+        return 0;
     }
-};
 
-/**
- * @brief Main function to initialize the ATM Management System
- * 
- * This function initializes the user structure and calls the main menu function
- * to start the ATM Management System.
- *
- * @return int Exit status of the program
- */
-int main()
-{
     // Initialize the user structure
-    system("clear");
+    clearScreen();
     struct User u;
+    initSystem();
+    loadRecords();
+    loadUsers();
+    atexit(saveStats);
     initMenu(&u);
     mainMenu(u);
     return 0;
@@ -0,0 +1,556 @@
+/**
+ * @file password.c
+ * @brief Password hashing of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * Passwords are stored as salted PBKDF2-HMAC-SHA256 hashes whose cost is
+ * the log2 of the iteration count. A stored hash fits the password field
+ * of the users file:
+ *
+ *   $pCC$<16 characters of salt><27 characters of hash>
+ *
+ * where CC is the two-digit cost, the salt is 12 random bytes and the hash
+ * the first 20 bytes of the PBKDF2 output, both in the crypt(3) base64
+ * alphabet. Any other stored password is an old plaintext one, still
+ * accepted so existing users files keep working until they are migrated.
+ *
+ * Hashing is slow on purpose, so it never runs on the caller's thread: it
+ * is queued to a pool of one worker per core, with a bounded queue. Login
+ * storms then use every core without ever running more hashes at once
+ * than there are cores, and the callers simply wait for their turn.
+ */
+
+#include "header.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+#define SALT_BYTES 12           ///< Random bytes of salt
+#define HASH_BYTES 20           ///< Bytes of the PBKDF2 output kept
+#define SALT_CHARS 16           ///< Base64 characters of the salt
+#define HASH_CHARS 27           ///< Base64 characters of the hash
+#define PREFIX_CHARS 5          ///< Characters of "$pCC$"
+
+static const char base64[] = "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+static const unsigned int roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const unsigned int initialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+/**
+ * @brief SHA-256 state over a message of any length
+ */
+struct Sha256
+{
+    unsigned int state[8];      ///< Chaining value
+    unsigned char block[64];    ///< Bytes not compressed yet
+    int used;                   ///< Number of bytes in block
+    unsigned long long length;  ///< Bytes hashed so far
+};
+
+/**
+ * @brief One piece of work for the hashing pool
+ */
+struct PasswordJob
+{
+    const char *password;       ///< Password to hash or check
+    char *stored;               ///< Stored password to check, or receives the new hash
+    int verify;                 ///< 1 to check against stored, 0 to hash into stored
+    int result;                 ///< 1 if the password matched, for checks
+    int done;                   ///< Set by the worker once the job is finished
+};
+
+static int passwordCost = PASSWORD_COST;
+static struct PasswordJob *jobs[PASSWORD_QUEUE];   ///< Jobs waiting for a worker
+static int jobHead;
+static int jobCount;
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobReady = PTHREAD_COND_INITIALIZER;     ///< A job was queued
+static pthread_cond_t jobRoom = PTHREAD_COND_INITIALIZER;      ///< The queue has room
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;      ///< A job was finished
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+
+static unsigned int rotate(unsigned int x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+/**
+ * @brief Compress one 64-byte block into a chaining value
+ */
+static void compress(unsigned int *state, const unsigned char *block)
+{
+    unsigned int w[64];
+    unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+    unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (unsigned int)block[i * 4] << 24 | block[i * 4 + 1] << 16 | block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        unsigned int s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        unsigned int s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    for (int i = 0; i < 64; i++)
+    {
+        unsigned int t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + roundConstants[i] + w[i];
+        unsigned int t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void shaInit(struct Sha256 *s)
+{
+    memcpy(s->state, initialState, sizeof(initialState));
+    s->used = 0;
+    s->length = 0;
+}
+
+static void shaUpdate(struct Sha256 *s, const unsigned char *data, size_t length)
+{
+    s->length += length;
+    while (length > 0)
+    {
+        size_t n = (size_t)(64 - s->used) < length ? (size_t)(64 - s->used) : length;
+        memcpy(s->block + s->used, data, n);
+        s->used += n;
+        data += n;
+        length -= n;
+        if (s->used == 64)
+        {
+            compress(s->state, s->block);
+            s->used = 0;
+        }
+    }
+}
+
+/**
+ * @brief Write a chaining value as the 32 bytes of a digest
+ */
+static void writeDigest(const unsigned int *state, unsigned char *digest)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = state[i] >> 24;
+        digest[i * 4 + 1] = state[i] >> 16;
+        digest[i * 4 + 2] = state[i] >> 8;
+        digest[i * 4 + 3] = state[i];
+    }
+}
+
+static void shaFinal(struct Sha256 *s, unsigned char *digest)
+{
+    unsigned long long bits = s->length * 8;
+    unsigned char pad[72] = {0x80};
+    size_t padLength = (s->used < 56 ? 56 : 120) - s->used;
+
+    for (int i = 0; i < 8; i++)
+    {
+        pad[padLength + i] = bits >> (56 - i * 8);
+    }
+    shaUpdate(s, pad, padLength + 8);
+    writeDigest(s->state, digest);
+}
+
+/**
+ * @brief Hash 32 bytes from a state that has hashed exactly one block
+ *
+ * The inner and outer hashes of every PBKDF2 iteration are such hashes,
+ * so each costs a single compression.
+ */
+static void hashDigest(const unsigned int *keyed, const unsigned char *digest, unsigned char *out)
+{
+    unsigned char block[64] = {0};
+    unsigned int state[8];
+
+    memcpy(block, digest, 32);
+    block[32] = 0x80;
+    block[62] = (64 + 32) * 8 >> 8;
+    block[63] = (unsigned char)((64 + 32) * 8);
+    memcpy(state, keyed, sizeof(state));
+    compress(state, block);
+    writeDigest(state, out);
+}
+
+/**
+ * @brief Derive a key with PBKDF2-HMAC-SHA256
+ *
+ * @param password Password, the HMAC key
+ * @param salt Salt
+ * @param saltLength Bytes of salt
+ * @param iterations Iteration count
+ * @param out Receives the key
+ * @param outLength Bytes of key wanted
+ */
+void pbkdf2Sha256(const char *password, const unsigned char *salt, size_t saltLength,
+                  unsigned long iterations, unsigned char *out, size_t outLength)
+{
+    unsigned char key[64] = {0};
+    unsigned char pad[64];
+    unsigned int inner[8], outer[8];
+    size_t keyLength = strlen(password);
+    struct Sha256 s;
+
+    if (keyLength > 64)
+    {
+        shaInit(&s);
+        shaUpdate(&s, (const unsigned char *)password, keyLength);
+        shaFinal(&s, key);
+    }
+    else
+    {
+        memcpy(key, password, keyLength);
+    }
+
+    // the keyed inner and outer states are the same for every iteration
+    for (int i = 0; i < 64; i++)
+    {
+        pad[i] = key[i] ^ 0x36;
+    }
+    memcpy(inner, initialState, sizeof(inner));
+    compress(inner, pad);
+    for (int i = 0; i < 64; i++)
+    {
+        pad[i] = key[i] ^ 0x5c;
+    }
+    memcpy(outer, initialState, sizeof(outer));
+    compress(outer, pad);
+
+    for (unsigned int blockIndex = 1; outLength > 0; blockIndex++)
+    {
+        unsigned char u[32], t[32];
+        unsigned char counter[4] = {blockIndex >> 24, blockIndex >> 16, blockIndex >> 8, blockIndex};
+
+        // U1 = HMAC(password, salt || counter)
+        memcpy(s.state, inner, sizeof(inner));
+        memset(s.block, 0, sizeof(s.block));
+        s.used = 0;
+        s.length = 64;
+        shaUpdate(&s, salt, saltLength);
+        shaUpdate(&s, counter, 4);
+        shaFinal(&s, u);
+        hashDigest(outer, u, u);
+        memcpy(t, u, 32);
+
+        for (unsigned long i = 1; i < iterations; i++)
+        {
+            hashDigest(inner, u, u);
+            hashDigest(outer, u, u);
+            for (int j = 0; j < 32; j++)
+            {
+                t[j] ^= u[j];
+            }
+        }
+
+        size_t n = outLength < 32 ? outLength : 32;
+        memcpy(out, t, n);
+        out += n;
+        outLength -= n;
+    }
+}
+
+/**
+ * @brief Write bytes in the crypt(3) base64 alphabet, without padding
+ */
+static void encode(const unsigned char *data, int length, char *out)
+{
+    for (int i = 0; i < length; i += 3)
+    {
+        unsigned int v = data[i] << 16 | (i + 1 < length ? data[i + 1] << 8 : 0) | (i + 2 < length ? data[i + 2] : 0);
+        int chars = i + 2 < length ? 4 : i + 1 < length ? 3 : 2;
+        for (int j = 0; j < chars; j++)
+        {
+            *out++ = base64[(v >> (18 - j * 6)) & 63];
+        }
+    }
+    *out = '\0';
+}
+
+/**
+ * @brief Read bytes written by encode
+ * @return 0 on success, 1 on a character outside the alphabet
+ */
+static int decode(const char *in, int length, unsigned char *out)
+{
+    unsigned int v = 0;
+    int bits = 0;
+
+    for (int n = 0; n < length;)
+    {
+        const char *p = *in ? strchr(base64, *in++) : NULL;
+        if (p == NULL)
+            return 1;
+        v = v << 6 | (p - base64);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out[n++] = v >> bits;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Check whether a stored password is a hash rather than plaintext
+ *
+ * @param stored Stored password
+ * @param cost Receives the cost of the hash, may be NULL
+ */
+int passwordHashed(const char *stored, int *cost)
+{
+    if (strlen(stored) != PREFIX_CHARS + SALT_CHARS + HASH_CHARS || strncmp(stored, "$p", 2) != 0 ||
+        stored[2] < '0' || stored[2] > '9' || stored[3] < '0' || stored[3] > '9' || stored[4] != '$')
+        return 0;
+    if (cost != NULL)
+        *cost = (stored[2] - '0') * 10 + (stored[3] - '0');
+    return 1;
+}
+
+/**
+ * @brief Hash a password with a new salt at the current cost, on the calling thread
+ */
+static void computeHash(const char *password, char *stored)
+{
+    unsigned char salt[SALT_BYTES];
+    unsigned char hash[HASH_BYTES];
+
+    if (getrandom(salt, sizeof(salt), 0) != sizeof(salt))
+    {
+        printf("Error! no random salt");
+        exit(1);
+    }
+    pbkdf2Sha256(password, salt, sizeof(salt), 1UL << passwordCost, hash, sizeof(hash));
+    sprintf(stored, "$p%02d$", passwordCost);
+    encode(salt, sizeof(salt), stored + PREFIX_CHARS);
+    encode(hash, sizeof(hash), stored + PREFIX_CHARS + SALT_CHARS);
+}
+
+/**
+ * @brief Check a password against a stored one, on the calling thread
+ */
+static int computeCheck(const char *password, const char *stored)
+{
+    unsigned char salt[SALT_BYTES];
+    unsigned char expected[HASH_BYTES];
+    unsigned char hash[HASH_BYTES];
+    unsigned char difference = 0;
+    int cost;
+
+    if (!passwordHashed(stored, &cost))
+        return strcmp(password, stored) == 0;
+    // a cost out of range is a corrupt hash, not hours of hashing
+    if (cost < PASSWORD_MIN_COST || cost > PASSWORD_MAX_COST ||
+        decode(stored + PREFIX_CHARS, SALT_BYTES, salt) != 0 ||
+        decode(stored + PREFIX_CHARS + SALT_CHARS, HASH_BYTES, expected) != 0)
+        return 0;
+    pbkdf2Sha256(password, salt, sizeof(salt), 1UL << cost, hash, sizeof(hash));
+
+    // compare every byte so the time does not tell how many matched
+    for (int i = 0; i < HASH_BYTES; i++)
+    {
+        difference |= hash[i] ^ expected[i];
+    }
+    return difference == 0;
+}
+
+/**
+ * @brief Hashing worker: run queued jobs forever
+ */
+static void *passwordWorker(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&jobLock);
+        while (jobCount == 0)
+        {
+            pthread_cond_wait(&jobReady, &jobLock);
+        }
+        struct PasswordJob *job = jobs[jobHead];
+        jobHead = (jobHead + 1) % PASSWORD_QUEUE;
+        jobCount--;
+        pthread_cond_signal(&jobRoom);
+        pthread_mutex_unlock(&jobLock);
+
+        if (job->verify)
+            job->result = computeCheck(job->password, job->stored);
+        else
+            computeHash(job->password, job->stored);
+
+        pthread_mutex_lock(&jobLock);
+        job->done = 1;
+        pthread_cond_broadcast(&jobDone);
+        pthread_mutex_unlock(&jobLock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start one hashing worker per core
+ */
+static void startPool(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t thread;
+
+    for (long i = 0; i < (cores > 0 ? cores : 1); i++)
+    {
+        if (pthread_create(&thread, NULL, passwordWorker, NULL) != 0)
+        {
+            perror("pthread_create");
+            exit(1);
+        }
+        pthread_detach(thread);
+    }
+}
+
+/**
+ * @brief Queue a job to the pool, assumes the job lock is held
+ *
+ * Waits for room first when PASSWORD_QUEUE jobs are already queued.
+ */
+static void queueJob(struct PasswordJob *job)
+{
+    job->done = 0;
+    while (jobCount == PASSWORD_QUEUE)
+    {
+        pthread_cond_wait(&jobRoom, &jobLock);
+    }
+    jobs[(jobHead + jobCount++) % PASSWORD_QUEUE] = job;
+    pthread_cond_signal(&jobReady);
+}
+
+/**
+ * @brief Wait until a queued job is done, assumes the job lock is held
+ */
+static void waitJob(const struct PasswordJob *job)
+{
+    while (!job->done)
+    {
+        pthread_cond_wait(&jobDone, &jobLock);
+    }
+}
+
+/**
+ * @brief Queue a job to the pool and wait until it is done
+ */
+static void runJob(struct PasswordJob *job)
+{
+    pthread_once(&poolOnce, startPool);
+    pthread_mutex_lock(&jobLock);
+    queueJob(job);
+    waitJob(job);
+    pthread_mutex_unlock(&jobLock);
+}
+
+/**
+ * @brief Hash a password with a new salt at the current cost
+ *
+ * @param password Password to hash
+ * @param stored Receives the hash, MAX_PASSWORD_SIZE bytes
+ */
+void hashPassword(const char *password, char *stored)
+{
+    struct PasswordJob job = {password, stored, 0, 0, 0};
+    runJob(&job);
+}
+
+/**
+ * @brief Hash many passwords on the pool at once
+ *
+ * Every job is queued before the first one is waited for, so all the
+ * workers hash together.
+ *
+ * @param passwords Passwords to hash
+ * @param stored Receive the hashes, MAX_PASSWORD_SIZE bytes each, apart from the passwords
+ * @param count Number of passwords
+ */
+void hashPasswords(const char **passwords, char **stored, int count)
+{
+    struct PasswordJob *batch;
+
+    if (count == 0)
+        return;
+    if ((batch = malloc(count * sizeof(struct PasswordJob))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    pthread_once(&poolOnce, startPool);
+    pthread_mutex_lock(&jobLock);
+    for (int i = 0; i < count; i++)
+    {
+        batch[i] = (struct PasswordJob){passwords[i], stored[i], 0, 0, 0};
+        queueJob(&batch[i]);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        waitJob(&batch[i]);
+    }
+    pthread_mutex_unlock(&jobLock);
+    free(batch);
+}
+
+/**
+ * @brief Check a password against a stored hash or an old plaintext password
+ *
+ * @return 1 if the password matches, 0 otherwise
+ */
+int checkPassword(const char *password, const char *stored)
+{
+    struct PasswordJob job = {password, (char *)stored, 1, 0, 0};
+    runJob(&job);
+    return job.result;
+}
+
+/**
+ * @brief Check whether a stored password should be hashed again at the current cost
+ */
+int passwordOutdated(const char *stored)
+{
+    int cost;
+    return !passwordHashed(stored, &cost) || cost != passwordCost;
+}
+
+/**
+ * @brief Set the cost of new hashes, the log2 of their PBKDF2 iterations
+ *
+ * Existing hashes keep their cost until their user logs in again.
+ */
+void setPasswordCost(int cost)
+{
+    if (cost < PASSWORD_MIN_COST)
+        cost = PASSWORD_MIN_COST;
+    if (cost > PASSWORD_MAX_COST)
+        cost = PASSWORD_MAX_COST;
+    passwordCost = cost;
+}
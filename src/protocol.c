@@ -0,0 +1,298 @@
+/**
+ * @file protocol.c
+ * @brief Line protocol of the ATM Management System server
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * Every request is one line made of a command and its arguments separated
+ * by spaces. Every response starts with a status line, either
+ * "OK [values]" or "ERR <message>". LIST answers "OK <n>" followed by n
+ * account lines, TRANSFERALL "OK <n>" with the number of accounts given.
+ * The operation statistics are not served to clients; the server writes
+ * them to STATS_FILE on SIGUSR1.
+ *
+ *   LOGIN <name> <password>
+ *   REGISTER <name> <password>
+ *   CREATE <account> <mm/dd/yyyy> <country> <phone> <amount> <type>
+ *   UPDATE <account> phone <number> | UPDATE <account> country <name>
+ *   CHECK <account>
+ *   LIST
+ *   DEPOSIT <account> <amount>
+ *   WITHDRAW <account> <amount>
+ *   MOVE <from account> <to account> <amount>
+ *   REMOVE <account>
+ *   TRANSFER <account> <user name>
+ *   TRANSFERALL <user name> [type]
+ *   HELP
+ *   QUIT
+ *
+ * Accounts are written as
+ * "<account> <mm/dd/yyyy> <country> <phone> <amount> <type>".
+ */
+
+#include "header.h"
+#include <ctype.h>
+#include <strings.h>
+
+/**
+ * @brief Write an account the way the protocol shows it
+ */
+static void writeAccount(FILE *out, const struct Record *r)
+{
+    fprintf(out, "%d %d/%d/%d %s %d %.2f %s\n",
+            r->accountNbr,
+            r->deposit.month,
+            r->deposit.day,
+            r->deposit.year,
+            r->country,
+            r->phone,
+            r->amount,
+            r->accountType);
+}
+
+/**
+ * @brief Write a result code as a status line
+ */
+static void writeResult(FILE *out, int result)
+{
+    if (result == OP_OK)
+        fprintf(out, "OK\n");
+    else
+        fprintf(out, "ERR %s\n", opMessage(result));
+}
+
+/**
+ * @brief Parse a non-negative integer argument
+ * @return 0 if the argument is valid, 1 otherwise
+ */
+static int parseInt(const char *arg, int *value)
+{
+    if (arg == NULL || checkValidType(arg, "int") != 0)
+        return 1;
+    *value = atoi(arg);
+    return *value < 0;
+}
+
+/**
+ * @brief Parse a non-negative amount argument
+ * @return 0 if the argument is valid, 1 otherwise
+ */
+static int parseAmount(const char *arg, double *value)
+{
+    if (arg == NULL || checkValidType(arg, "flt") != 0)
+        return 1;
+    *value = atof(arg);
+    return 0;
+}
+
+/**
+ * @brief State passed to the LIST callback
+ */
+struct ListState
+{
+    FILE *out;  ///< Stream receiving the account lines
+    int count;  ///< Number of accounts written
+};
+
+/**
+ * @brief Write one account of a LIST response
+ */
+static void listOne(const struct Record *r, void *arg)
+{
+    struct ListState *state = arg;
+    writeAccount(state->out, r);
+    state->count++;
+}
+
+/**
+ * @brief Handle one request of a session
+ *
+ * @param s Session the request belongs to
+ * @param line Request line, modified while it is parsed
+ * @param out Stream receiving the response
+ * @return 0 to keep the session open, 1 when the client asked to quit
+ */
+int handleRequest(struct Session *s, char *line, FILE *out)
+{
+    char *save;
+    char *args[8] = {0};
+    int argc = 0;
+    int account;
+    double amount;
+    struct Record r;
+
+    for (char *tok = strtok_r(line, " \t\r\n", &save); tok != NULL && argc < 8; tok = strtok_r(NULL, " \t\r\n", &save))
+    {
+        args[argc++] = tok;
+    }
+    if (argc == 0)
+    {
+        fprintf(out, "ERR Empty request\n");
+        return 0;
+    }
+
+    const char *cmd = args[0];
+    if (strcasecmp(cmd, "QUIT") == 0)
+    {
+        fprintf(out, "OK\n");
+        return 1;
+    }
+    if (strcasecmp(cmd, "HELP") == 0)
+    {
+        fprintf(out, "OK LOGIN REGISTER CREATE UPDATE CHECK LIST DEPOSIT WITHDRAW MOVE REMOVE TRANSFER TRANSFERALL QUIT\n");
+        return 0;
+    }
+    if (strcasecmp(cmd, "LOGIN") == 0 || strcasecmp(cmd, "REGISTER") == 0)
+    {
+        struct User u;
+        if (argc != 3 || strlen(args[1]) >= MAX_USERNAME_SIZE || strlen(args[2]) >= MAX_PASSWORD_SIZE)
+        {
+            writeResult(out, OP_INVALID);
+            return 0;
+        }
+        strcpy(u.name, args[1]);
+        strcpy(u.password, args[2]);
+        int result = toupper((unsigned char)cmd[0]) == 'L' ? loginUser(&u) : registerNewUser(&u);
+        if (result == OP_OK)
+        {
+            s->user = u;
+            s->loggedIn = 1;
+            fprintf(out, "OK %d\n", u.id);
+        }
+        else
+        {
+            writeResult(out, result);
+        }
+        return 0;
+    }
+
+    if (!s->loggedIn)
+    {
+        fprintf(out, "ERR Please login first\n");
+        return 0;
+    }
+
+    if (strcasecmp(cmd, "CREATE") == 0)
+    {
+        if (argc != 7 || parseInt(args[1], &r.accountNbr) ||
+            sscanf(args[2], "%d/%d/%d", &r.deposit.month, &r.deposit.day, &r.deposit.year) != 3 ||
+            strlen(args[3]) >= MAX_COUNTRY_SIZE || parseInt(args[4], &r.phone) ||
+            parseAmount(args[5], &r.amount) || strlen(args[6]) >= MAX_TRANSACTION_TYPE_SIZE)
+        {
+            writeResult(out, OP_INVALID);
+            return 0;
+        }
+        strcpy(r.country, args[3]);
+        strcpy(r.accountType, args[6]);
+        if (checkValidType(r.country, "str") != 0)
+        {
+            writeResult(out, OP_INVALID);
+            return 0;
+        }
+        writeResult(out, openAccount(s->user, &r));
+    }
+    else if (strcasecmp(cmd, "UPDATE") == 0)
+    {
+        int phone = 0;
+        if (argc != 4 || parseInt(args[1], &account))
+            writeResult(out, OP_INVALID);
+        else if (strcasecmp(args[2], "phone") == 0)
+            writeResult(out, parseInt(args[3], &phone) ? OP_INVALID : changeAccountInfo(s->user, account, phone, NULL));
+        else if (strcasecmp(args[2], "country") == 0 && strlen(args[3]) < MAX_COUNTRY_SIZE)
+            writeResult(out, changeAccountInfo(s->user, account, 0, args[3]));
+        else
+            writeResult(out, OP_INVALID);
+    }
+    else if (strcasecmp(cmd, "CHECK") == 0)
+    {
+        int result = argc != 2 || parseInt(args[1], &account) ? OP_INVALID : getAccount(s->user, account, &r);
+        if (result == OP_OK)
+        {
+            fprintf(out, "OK ");
+            writeAccount(out, &r);
+        }
+        else
+        {
+            writeResult(out, result);
+        }
+    }
+    else if (strcasecmp(cmd, "LIST") == 0)
+    {
+        struct ListState state = {NULL, 0};
+        char *lines = NULL;
+        size_t length = 0;
+
+        if ((state.out = open_memstream(&lines, &length)) == NULL)
+        {
+            fprintf(out, "ERR Out of memory\n");
+            return 0;
+        }
+        listAccounts(s->user, listOne, &state);
+        fclose(state.out);
+        fprintf(out, "OK %d\n", state.count);
+        fwrite(lines, 1, length, out);
+        free(lines);
+    }
+    else if (strcasecmp(cmd, "DEPOSIT") == 0 || strcasecmp(cmd, "WITHDRAW") == 0)
+    {
+        double balance;
+        if (argc != 3 || parseInt(args[1], &account) || parseAmount(args[2], &amount))
+        {
+            writeResult(out, OP_INVALID);
+            return 0;
+        }
+        int result = transact(s->user, account, toupper((unsigned char)cmd[0]) == 'D' ? amount : -amount, &balance);
+        if (result == OP_OK)
+            fprintf(out, "OK %.2f\n", balance);
+        else
+            writeResult(out, result);
+    }
+    else if (strcasecmp(cmd, "MOVE") == 0)
+    {
+        double balance;
+        int to;
+        if (argc != 4 || parseInt(args[1], &account) || parseInt(args[2], &to) || parseAmount(args[3], &amount))
+        {
+            writeResult(out, OP_INVALID);
+            return 0;
+        }
+        int result = moveFunds(s->user, account, to, amount, &balance);
+        if (result == OP_OK)
+            fprintf(out, "OK %.2f\n", balance);
+        else
+            writeResult(out, result);
+    }
+    else if (strcasecmp(cmd, "REMOVE") == 0)
+    {
+        if (argc != 2 || parseInt(args[1], &account))
+            writeResult(out, OP_INVALID);
+        else
+            writeResult(out, closeAccount(s->user, account, NULL));
+    }
+    else if (strcasecmp(cmd, "TRANSFER") == 0)
+    {
+        if (argc != 3 || parseInt(args[1], &account))
+            writeResult(out, OP_INVALID);
+        else
+            writeResult(out, giveAccount(s->user, account, args[2]));
+    }
+    else if (strcasecmp(cmd, "TRANSFERALL") == 0)
+    {
+        int given;
+        if (argc < 2 || argc > 3)
+        {
+            writeResult(out, OP_INVALID);
+            return 0;
+        }
+        int result = giveAllAccounts(s->user, args[1], argc == 3 ? args[2] : NULL, &given);
+        if (result == OP_OK)
+            fprintf(out, "OK %d\n", given);
+        else
+            writeResult(out, result);
+    }
+    else
+    {
+        fprintf(out, "ERR Unknown command %s\n", cmd);
+    }
+    return 0;
+}
@@ -0,0 +1,523 @@
+/**
+ * @file report.c
+ * @brief Aggregate reports over the account book
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * A report totals the balances of the bank by country, by account type
+ * and by owner, and lists the owners holding the most, in one pass over
+ * the records.
+ *
+ * The slots of every shard are cut into chunks of REPORT_CHUNK slots that
+ * the worker threads claim one at a time, so a large shard does not leave
+ * the other workers idle. Each worker adds into tables of its own and
+ * shares nothing with the others but the chunk counter. The owner tables
+ * of a worker are split into one part per worker by a hash of the owner
+ * id; once the scan is done, worker k merges part k of every worker and
+ * keeps the top owners of that part, so the merge runs in parallel too.
+ * Only the small country and type tables and the per-part top owners are
+ * merged by the calling thread.
+ *
+ * Balances are summed as whole cents in integers, so the totals are exact
+ * and the report is the same whatever the number of workers.
+ *
+ * The book is frozen for the whole pass, see readAllAccounts, so the
+ * totals describe one moment.
+ */
+
+#include "header.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define REPORT_CHUNK 65536      ///< Slots a worker claims at a time
+#define REPORT_MAX_THREADS 64   ///< Most report workers
+
+/**
+ * @brief Accounts and balance of one country or account type
+ */
+struct NameTotal
+{
+    char name[MAX_COUNTRY_SIZE];    ///< Country or account type
+    long long accounts;             ///< Number of accounts, 0 for an empty entry
+    long long cents;                ///< Sum of the balances in cents
+};
+
+/**
+ * @brief Open addressing table of name totals
+ */
+struct NameTable
+{
+    struct NameTotal *entries;
+    int count;
+    int capacity;       ///< Always a power of two
+};
+
+/**
+ * @brief Accounts and balance of one owner
+ */
+struct OwnerTotal
+{
+    int userId;             ///< Id of the owner
+    int accounts;           ///< Number of accounts, 0 for an empty entry
+    long long cents;        ///< Sum of the balances in cents
+    const char *name;       ///< Name of the owner, in the string pool
+};
+
+/**
+ * @brief Open addressing table of owner totals
+ */
+struct OwnerTable
+{
+    struct OwnerTotal *entries;
+    int count;
+    int capacity;       ///< Always a power of two
+};
+
+/**
+ * @brief Slots of one shard claimed by a worker at once
+ */
+struct Chunk
+{
+    int shard;
+    int from;           ///< First slot
+    int to;             ///< Slot past the last one
+};
+
+struct Report;
+
+/**
+ * @brief Tables and results of one worker
+ */
+struct ReportWorker
+{
+    struct Report *report;
+    int index;                  ///< Position among the workers
+    long long accounts;         ///< Accounts seen
+    long long cents;            ///< Sum of their balances
+    struct NameTable countries;
+    struct NameTable types;
+    struct OwnerTable *owners;  ///< One part per worker
+    struct OwnerTotal *top;     ///< Top owners of part index, once merged
+    int topCount;
+};
+
+/**
+ * @brief State shared by the workers of a report
+ */
+struct Report
+{
+    int threads;
+    int top;                    ///< Owners to list
+    struct Chunk *chunks;
+    int chunkCount;
+    int nextChunk;              ///< Next chunk to claim
+    struct ReportWorker workers[REPORT_MAX_THREADS];
+};
+
+/**
+ * @brief Convert a balance to whole cents, rounding half away from zero
+ */
+static long long toCents(double amount)
+{
+    return (long long)(amount * 100 + (amount < 0 ? -0.5 : 0.5));
+}
+
+/**
+ * @brief Allocate zeroed memory or exit
+ */
+static void *allocate(size_t count, size_t size)
+{
+    void *p = calloc(count, size);
+    if (p == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    return p;
+}
+
+/**
+ * @brief Hash a name with FNV-1a
+ */
+static unsigned int hashName(const char *name)
+{
+    unsigned int h = 2166136261u;
+    while (*name)
+    {
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Add accounts to the total of a name, growing the table when half full
+ */
+static void addName(struct NameTable *t, const char *name, long long accounts, long long cents)
+{
+    if ((t->count + 1) * 2 > t->capacity)
+    {
+        struct NameTable grown = {allocate(t->capacity ? t->capacity * 2 : 16, sizeof(struct NameTotal)), 0,
+                                  t->capacity ? t->capacity * 2 : 16};
+        for (int i = 0; i < t->capacity; i++)
+        {
+            if (t->entries[i].accounts > 0)
+                addName(&grown, t->entries[i].name, t->entries[i].accounts, t->entries[i].cents);
+        }
+        free(t->entries);
+        *t = grown;
+    }
+
+    unsigned int i = hashName(name) & (t->capacity - 1);
+    while (t->entries[i].accounts > 0 && strcmp(t->entries[i].name, name) != 0)
+    {
+        i = (i + 1) & (t->capacity - 1);
+    }
+    if (t->entries[i].accounts == 0)
+    {
+        strcpy(t->entries[i].name, name);
+        t->count++;
+    }
+    t->entries[i].accounts += accounts;
+    t->entries[i].cents += cents;
+}
+
+/**
+ * @brief Add accounts to the total of an owner, growing the table when half full
+ */
+static void addOwner(struct OwnerTable *t, int userId, const char *name, int accounts, long long cents)
+{
+    if ((t->count + 1) * 2 > t->capacity)
+    {
+        struct OwnerTable grown = {allocate(t->capacity ? t->capacity * 2 : 64, sizeof(struct OwnerTotal)), 0,
+                                   t->capacity ? t->capacity * 2 : 64};
+        for (int i = 0; i < t->capacity; i++)
+        {
+            const struct OwnerTotal *o = &t->entries[i];
+            if (o->accounts > 0)
+                addOwner(&grown, o->userId, o->name, o->accounts, o->cents);
+        }
+        free(t->entries);
+        *t = grown;
+    }
+
+    unsigned int i = ((unsigned int)userId * 2654435769u) & (t->capacity - 1);
+    while (t->entries[i].accounts > 0 && t->entries[i].userId != userId)
+    {
+        i = (i + 1) & (t->capacity - 1);
+    }
+    if (t->entries[i].accounts == 0)
+    {
+        unsigned int id;
+        t->entries[i].userId = userId;
+        // the scan passes copies of the records, the pooled name outlives them
+        t->entries[i].name = internFind(POOL_NAMES, name, &id) ? internString(POOL_NAMES, id) : "";
+        t->count++;
+    }
+    t->entries[i].accounts += accounts;
+    t->entries[i].cents += cents;
+}
+
+/**
+ * @brief Get the owner table part of an owner
+ */
+static int ownerPart(int userId, int parts)
+{
+    // the high bits pick the part, the tables use the low ones
+    unsigned int h = (unsigned int)userId * 2654435769u;
+    return (int)(((unsigned long long)h * parts) >> 32);
+}
+
+/**
+ * @brief Add one account to the tables of a worker
+ */
+static void addAccount(const struct Record *r, void *arg)
+{
+    struct ReportWorker *w = arg;
+    long long cents = toCents(r->amount);
+
+    w->accounts++;
+    w->cents += cents;
+    addName(&w->countries, r->country, 1, cents);
+    addName(&w->types, r->accountType, 1, cents);
+    addOwner(&w->owners[ownerPart(r->userId, w->report->threads)], r->userId, r->name, 1, cents);
+}
+
+/**
+ * @brief Worker of the scan: claim chunks until none are left
+ */
+static void *scanWorker(void *arg)
+{
+    struct ReportWorker *w = arg;
+    struct Report *report = w->report;
+    int chunk;
+
+    while ((chunk = __atomic_fetch_add(&report->nextChunk, 1, __ATOMIC_RELAXED)) < report->chunkCount)
+    {
+        const struct Chunk *c = &report->chunks[chunk];
+        forEachAccountInSlots(c->shard, c->from, c->to, addAccount, w);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Check whether an owner ranks before another: larger balance, then smaller id
+ */
+static int ranksBefore(const struct OwnerTotal *a, const struct OwnerTotal *b)
+{
+    return a->cents != b->cents ? a->cents > b->cents : a->userId < b->userId;
+}
+
+/**
+ * @brief Offer an owner to a ranked list of at most max owners
+ */
+static void offerTop(struct OwnerTotal *top, int *count, int max, const struct OwnerTotal *o)
+{
+    int i = *count;
+
+    if (max == 0 || (i == max && !ranksBefore(o, &top[max - 1])))
+        return;
+    if (i == max)
+        i--;
+    else
+        (*count)++;
+    while (i > 0 && ranksBefore(o, &top[i - 1]))
+    {
+        top[i] = top[i - 1];
+        i--;
+    }
+    top[i] = *o;
+}
+
+/**
+ * @brief Worker of the merge: merge one owner part of every worker and rank it
+ */
+static void *mergeWorker(void *arg)
+{
+    struct ReportWorker *w = arg;
+    struct Report *report = w->report;
+    struct OwnerTable merged = {0};
+
+    for (int k = 0; k < report->threads; k++)
+    {
+        const struct OwnerTable *part = &report->workers[k].owners[w->index];
+        for (int i = 0; i < part->capacity; i++)
+        {
+            const struct OwnerTotal *o = &part->entries[i];
+            if (o->accounts > 0)
+                addOwner(&merged, o->userId, o->name, o->accounts, o->cents);
+        }
+    }
+    w->top = allocate(report->top + 1, sizeof(struct OwnerTotal));
+    for (int i = 0; i < merged.capacity; i++)
+    {
+        if (merged.entries[i].accounts > 0)
+            offerTop(w->top, &w->topCount, report->top, &merged.entries[i]);
+    }
+    free(merged.entries);
+    return NULL;
+}
+
+/**
+ * @brief Run a function on every worker, each in its own thread
+ */
+static void runWorkers(struct Report *report, void *(*fn)(void *))
+{
+    pthread_t tid[REPORT_MAX_THREADS];
+    int started[REPORT_MAX_THREADS];
+
+    for (int k = 0; k < report->threads; k++)
+    {
+        started[k] = k > 0 && pthread_create(&tid[k], NULL, fn, &report->workers[k]) == 0;
+    }
+    // the calling thread is worker 0, and stands in for any worker that did not start
+    fn(&report->workers[0]);
+    for (int k = 1; k < report->threads; k++)
+    {
+        if (started[k])
+            pthread_join(tid[k], NULL);
+        else
+            fn(&report->workers[k]);
+    }
+}
+
+/**
+ * @brief Cut the slots of every shard into chunks
+ */
+static void cutChunks(struct Report *report)
+{
+    int count = 0;
+
+    for (int k = 0; k < storeShards(); k++)
+    {
+        count += (shardSlots(k) + REPORT_CHUNK - 1) / REPORT_CHUNK;
+    }
+    report->chunks = allocate(count + 1, sizeof(struct Chunk));
+    for (int k = 0; k < storeShards(); k++)
+    {
+        for (int from = 0; from < shardSlots(k); from += REPORT_CHUNK)
+        {
+            struct Chunk *c = &report->chunks[report->chunkCount++];
+            c->shard = k;
+            c->from = from;
+            c->to = from + REPORT_CHUNK < shardSlots(k) ? from + REPORT_CHUNK : shardSlots(k);
+        }
+    }
+}
+
+/**
+ * @brief Compare two name totals by name for qsort
+ */
+static int compareNames(const void *a, const void *b)
+{
+    return strcmp(((const struct NameTotal *)a)->name, ((const struct NameTotal *)b)->name);
+}
+
+/**
+ * @brief Compare two owner totals by rank for qsort
+ */
+static int compareOwners(const void *a, const void *b)
+{
+    return ranksBefore(a, b) ? -1 : ranksBefore(b, a);
+}
+
+/**
+ * @brief Print an amount of cents as a balance
+ */
+static void printCents(FILE *out, long long cents)
+{
+    unsigned long long magnitude = cents < 0 ? -(unsigned long long)cents : (unsigned long long)cents;
+    fprintf(out, "%s%llu.%02llu", cents < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+}
+
+/**
+ * @brief Print the entries of a name table, sorted by name
+ */
+static void printNames(FILE *out, const char *kind, struct NameTable *t)
+{
+    struct NameTotal *sorted = allocate(t->count + 1, sizeof(struct NameTotal));
+    int count = 0;
+
+    for (int i = 0; i < t->capacity; i++)
+    {
+        if (t->entries[i].accounts > 0)
+            sorted[count++] = t->entries[i];
+    }
+    qsort(sorted, count, sizeof(struct NameTotal), compareNames);
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(out, "%s %s accounts=%lld total=", kind, sorted[i].name, sorted[i].accounts);
+        printCents(out, sorted[i].cents);
+        fputc('\n', out);
+    }
+    free(sorted);
+}
+
+/**
+ * @brief Arguments of buildReport
+ */
+struct ReportRun
+{
+    struct Report *report;
+    FILE *out;
+};
+
+/**
+ * @brief Scan, merge and print a report, with the book frozen
+ */
+static void buildReport(void *arg)
+{
+    struct ReportRun *run = arg;
+    struct Report *report = run->report;
+    struct ReportWorker *first = &report->workers[0];
+    struct OwnerTotal *top = allocate((size_t)report->threads * report->top + 1, sizeof(struct OwnerTotal));
+    int topCount = 0;
+
+    cutChunks(report);
+    runWorkers(report, scanWorker);
+    runWorkers(report, mergeWorker);
+
+    for (int k = 1; k < report->threads; k++)
+    {
+        struct ReportWorker *w = &report->workers[k];
+        first->accounts += w->accounts;
+        first->cents += w->cents;
+        for (int i = 0; i < w->countries.capacity; i++)
+        {
+            if (w->countries.entries[i].accounts > 0)
+                addName(&first->countries, w->countries.entries[i].name, w->countries.entries[i].accounts,
+                        w->countries.entries[i].cents);
+        }
+        for (int i = 0; i < w->types.capacity; i++)
+        {
+            if (w->types.entries[i].accounts > 0)
+                addName(&first->types, w->types.entries[i].name, w->types.entries[i].accounts,
+                        w->types.entries[i].cents);
+        }
+    }
+    for (int k = 0; k < report->threads; k++)
+    {
+        memcpy(&top[topCount], report->workers[k].top, report->workers[k].topCount * sizeof(struct OwnerTotal));
+        topCount += report->workers[k].topCount;
+    }
+    qsort(top, topCount, sizeof(struct OwnerTotal), compareOwners);
+
+    fprintf(run->out, "bank accounts=%lld total=", first->accounts);
+    printCents(run->out, first->cents);
+    fputc('\n', run->out);
+    printNames(run->out, "country", &first->countries);
+    printNames(run->out, "type", &first->types);
+    for (int i = 0; i < topCount && i < report->top; i++)
+    {
+        fprintf(run->out, "owner %s id=%d accounts=%d total=", top[i].name, top[i].userId, top[i].accounts);
+        printCents(run->out, top[i].cents);
+        fputc('\n', run->out);
+    }
+    free(top);
+}
+
+/**
+ * @brief Write the aggregate report of the whole book
+ *
+ * The report starts with a "bank" line holding the number of accounts and
+ * their total balance, followed by one "country" line per country and one
+ * "type" line per account type, sorted by name, then one "owner" line for
+ * each of the top owners by total balance. Every line ends with
+ * accounts=<n> total=<balance>.
+ *
+ * @param out Stream receiving the report
+ * @param top Number of owners to list
+ * @param threads Number of workers, 0 for one per core
+ */
+void writeReport(FILE *out, int top, int threads)
+{
+    struct Report *report = allocate(1, sizeof(struct Report));
+    struct ReportRun run = {report, out};
+
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    report->threads = threads < 1 ? 1 : threads > REPORT_MAX_THREADS ? REPORT_MAX_THREADS : threads;
+    report->top = top < 0 ? 0 : top;
+    for (int k = 0; k < report->threads; k++)
+    {
+        report->workers[k].report = report;
+        report->workers[k].index = k;
+        report->workers[k].owners = allocate(report->threads, sizeof(struct OwnerTable));
+    }
+
+    readAllAccounts(buildReport, &run);
+
+    for (int k = 0; k < report->threads; k++)
+    {
+        struct ReportWorker *w = &report->workers[k];
+        free(w->countries.entries);
+        free(w->types.entries);
+        for (int i = 0; i < report->threads; i++)
+        {
+            free(w->owners[i].entries);
+        }
+        free(w->owners);
+        free(w->top);
+    }
+    free(report->chunks);
+    free(report);
+}
@@ -0,0 +1,407 @@
+/**
+ * @file server.c
+ * @brief Multi-session server and thin client of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * The server keeps the accounts and users in memory and serves many
+ * sessions over a local Unix domain socket using the line protocol of
+ * protocol.c. A poller thread waits on every idle connection and hands
+ * the ones with pending requests to a fixed pool of worker threads; once
+ * a worker has answered, the connection goes back to the poller. An idle
+ * session therefore holds no thread.
+ *
+ * On SIGUSR1 the server writes the operation statistics to STATS_FILE.
+ *
+ * The headless mode serves one session on the standard input and output
+ * with the same protocol, for scripts and load tests, and writes the
+ * statistics to STATS_FILE when the session ends.
+ *
+ * The client forwards the requests typed on its standard input to the
+ * server and prints the responses.
+ */
+
+#include "header.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+const char *SOCKET_PATH = "./data/atm.sock";
+
+/**
+ * @brief One client connection of the server
+ */
+struct Connection
+{
+    int fd;                         ///< Connected socket
+    int out;                        ///< Descriptor receiving the responses, fd for sockets
+    struct Session session;         ///< Protocol state of the connection
+    char buffer[REQUEST_SIZE];      ///< Bytes received but not handled yet
+    int length;                     ///< Number of bytes in the buffer
+};
+
+static struct Connection *queue[MAX_CONNECTIONS];  ///< Connections with pending requests
+static int queueHead;
+static int queueCount;
+static int connectionCount;     ///< Open connections, never more than MAX_CONNECTIONS
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueReady = PTHREAD_COND_INITIALIZER;
+
+static int wakeup[2];   ///< Pipe the workers use to hand connections back to the poller
+static volatile sig_atomic_t statsWanted;   ///< Set by SIGUSR1
+
+/**
+ * @brief Queue a connection for the workers
+ */
+static void enqueue(struct Connection *c)
+{
+    pthread_mutex_lock(&queueLock);
+    queue[(queueHead + queueCount++) % MAX_CONNECTIONS] = c;
+    pthread_cond_signal(&queueReady);
+    pthread_mutex_unlock(&queueLock);
+}
+
+/**
+ * @brief Wait for a connection with pending requests
+ */
+static struct Connection *dequeue(void)
+{
+    pthread_mutex_lock(&queueLock);
+    while (queueCount == 0)
+    {
+        pthread_cond_wait(&queueReady, &queueLock);
+    }
+    struct Connection *c = queue[queueHead];
+    queueHead = (queueHead + 1) % MAX_CONNECTIONS;
+    queueCount--;
+    pthread_mutex_unlock(&queueLock);
+    return c;
+}
+
+/**
+ * @brief Write a whole buffer to a socket
+ * @return 0 on success, 1 if the peer is gone
+ */
+static int writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 1;
+        data += n;
+        length -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Read the pending bytes of a connection and answer every complete request
+ *
+ * The responses to all the requests read at once go out in one write.
+ *
+ * @return 0 to keep the connection, 1 to close it
+ */
+static int serveConnection(struct Connection *c)
+{
+    ssize_t n = read(c->fd, c->buffer + c->length, sizeof(c->buffer) - 1 - c->length);
+    if (n <= 0)
+        return n < 0 && errno == EINTR ? 0 : 1;
+    c->length += n;
+    c->buffer[c->length] = '\0';
+
+    char *response = NULL;
+    size_t length = 0;
+    FILE *out;
+    int quit = 0;
+
+    if ((out = open_memstream(&response, &length)) == NULL)
+        return 1;
+    char *line = c->buffer;
+    char *end;
+    while (!quit && (end = strchr(line, '\n')) != NULL)
+    {
+        *end = '\0';
+        quit = handleRequest(&c->session, line, out);
+        line = end + 1;
+    }
+    fclose(out);
+    quit |= writeAll(c->out, response, length);
+    free(response);
+    if (quit)
+        return 1;
+
+    c->length -= line - c->buffer;
+    memmove(c->buffer, line, c->length);
+    if (c->length == (int)sizeof(c->buffer) - 1)
+    {
+        const char *error = "ERR Request too long\n";
+        writeAll(c->out, error, strlen(error));
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Worker thread: answer queued connections forever
+ */
+static void *worker(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        struct Connection *c = dequeue();
+        if (serveConnection(c))
+        {
+            close(c->fd);
+            free(c);
+            pthread_mutex_lock(&queueLock);
+            connectionCount--;
+            pthread_mutex_unlock(&queueLock);
+        }
+        else if (write(wakeup[1], &c, sizeof(c)) != sizeof(c))
+        {
+            perror("write");
+            exit(1);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief SIGUSR1 handler: ask the poller to save the statistics
+ */
+static void requestStats(int sig)
+{
+    (void)sig;
+    statsWanted = 1;
+}
+
+/**
+ * @brief Open the listening socket
+ */
+static int listenOn(const char *path)
+{
+    struct sockaddr_un addr = {0};
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("Error! socket path too long\n");
+        exit(1);
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    unlink(path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 128) != 0)
+    {
+        perror("socket");
+        exit(1);
+    }
+    return fd;
+}
+
+/**
+ * @brief Run the server until it is killed
+ *
+ * @param path Path of the Unix domain socket
+ * @param workers Number of worker threads
+ */
+void runServer(const char *path, int workers)
+{
+    static struct pollfd fds[MAX_CONNECTIONS + 2];
+    static struct Connection *idle[MAX_CONNECTIONS];
+    int idleCount = 0;
+    pthread_t thread;
+
+    initSystem();
+    loadRecords();
+    loadUsers();
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGUSR1, requestStats);
+    if (pipe(wakeup) != 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+    int listener = listenOn(path);
+
+    // workers block SIGUSR1 so it always interrupts the poller
+    sigset_t usr1;
+    sigemptyset(&usr1);
+    sigaddset(&usr1, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &usr1, NULL);
+    for (int i = 0; i < workers; i++)
+    {
+        if (pthread_create(&thread, NULL, worker, NULL) != 0)
+        {
+            perror("pthread_create");
+            exit(1);
+        }
+        pthread_detach(thread);
+    }
+    pthread_sigmask(SIG_UNBLOCK, &usr1, NULL);
+    printf("ATM server listening on %s with %d workers\n", path, workers);
+    fflush(stdout);
+
+    for (;;)
+    {
+        fds[0].fd = listener;
+        pthread_mutex_lock(&queueLock);
+        fds[0].events = connectionCount < MAX_CONNECTIONS ? POLLIN : 0;
+        pthread_mutex_unlock(&queueLock);
+        fds[1].fd = wakeup[0];
+        fds[1].events = POLLIN;
+        for (int i = 0; i < idleCount; i++)
+        {
+            fds[i + 2].fd = idle[i]->fd;
+            fds[i + 2].events = POLLIN;
+        }
+        int ready = poll(fds, idleCount + 2, -1);
+        if (statsWanted)
+        {
+            statsWanted = 0;
+            saveStats();
+        }
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            exit(1);
+        }
+
+        // connections with pending bytes leave the idle set for a worker
+        int kept = 0;
+        for (int i = 0; i < idleCount; i++)
+        {
+            if (fds[i + 2].revents)
+                enqueue(idle[i]);
+            else
+                idle[kept++] = idle[i];
+        }
+        idleCount = kept;
+
+        if (fds[1].revents & POLLIN)
+        {
+            struct Connection *c;
+            if (read(wakeup[0], &c, sizeof(c)) == sizeof(c))
+                idle[idleCount++] = c;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(listener, NULL, NULL);
+            struct Connection *c;
+            if (fd == -1)
+                continue;
+            if ((c = calloc(1, sizeof(struct Connection))) == NULL)
+            {
+                close(fd);
+                continue;
+            }
+            c->fd = fd;
+            c->out = fd;
+            idle[idleCount++] = c;
+            pthread_mutex_lock(&queueLock);
+            connectionCount++;
+            pthread_mutex_unlock(&queueLock);
+        }
+    }
+}
+
+/**
+ * @brief Serve one protocol session on the standard input and output
+ *
+ * Requests are read until QUIT or the end of the input, with no screen,
+ * prompt or retry loop; every response is written as soon as the
+ * requests read with it are answered.
+ *
+ * @return Exit status of the session
+ */
+int runHeadless(void)
+{
+    static struct Connection c;
+
+    initSystem();
+    loadRecords();
+    loadUsers();
+    signal(SIGPIPE, SIG_IGN);
+
+    c.fd = STDIN_FILENO;
+    c.out = STDOUT_FILENO;
+    while (!serveConnection(&c))
+    {
+    }
+    saveStats();
+    return 0;
+}
+
+/**
+ * @brief Forward requests from the standard input to the server
+ *
+ * @param path Path of the server's Unix domain socket
+ * @return Exit status of the client
+ */
+int runClient(const char *path)
+{
+    struct sockaddr_un addr = {0};
+    char line[REQUEST_SIZE];
+    FILE *in;
+    int fd;
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        (in = fdopen(fd, "r")) == NULL)
+    {
+        perror("connect");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int prompt = isatty(fileno(stdin));
+    for (;;)
+    {
+        if (prompt)
+        {
+            printf("atm> ");
+            fflush(stdout);
+        }
+        if (fgets(line, sizeof(line), stdin) == NULL)
+            break;
+        if (strchr(line, '\n') == NULL)
+            strcat(line, "\n");
+        if (writeAll(fd, line, strlen(line)))
+            break;
+
+        int lines = 1;
+        int count;
+        int list = strncasecmp(line, "LIST", 4) == 0;
+        while (lines-- > 0 && fgets(line, sizeof(line), in) != NULL)
+        {
+            fputs(line, stdout);
+            if (list && sscanf(line, "OK %d", &count) == 1)
+            {
+                lines = count;
+                list = 0;
+            }
+        }
+        if (lines >= 0)
+            break;
+    }
+    fclose(in);
+    return 0;
+}
@@ -0,0 +1,416 @@
+/**
+ * @file snapshot.c
+ * @brief Binary snapshots of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * A snapshot holds every live account and every user in binary form, so
+ * startup reads it in a few large reads instead of parsing the text files,
+ * then replays only the logs written since.
+ *
+ * The file starts with a header, followed by the records laid out as
+ * struct Slot, shard after shard, the users laid out as struct User, and
+ * the string pools the slots refer to, each as its byte count and its
+ * blocks. The header keeps the number of records of every shard, how many
+ * bytes of the users file the users cover, so only the tail of that file
+ * is parsed at startup, and the generation of the last log the snapshot
+ * covers. A snapshot of another version or written by a build with other
+ * struct sizes is refused.
+ *
+ * Checkpoints take a snapshot without blocking the bank: under the
+ * exclusive store lock the log is rotated and the process forks, which is
+ * all the lock covers. The child writes the copy-on-write image of the
+ * records and users to a temp file, syncs it and renames it over the
+ * snapshot, using nothing but system calls. The parent reaps the child
+ * later and removes the rotated logs the new snapshot covers. If the
+ * process cannot fork, the snapshot is written in place instead.
+ */
+
+#include "header.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+const char *SNAPSHOT = "./data/snapshot.bin";
+
+#define SNAPSHOT_MAGIC "ATMS"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 512    ///< Header size, keeps the records aligned
+
+/**
+ * @brief Header at the start of a snapshot
+ */
+struct SnapshotHeader
+{
+    char magic[4];          ///< Always SNAPSHOT_MAGIC
+    int version;            ///< Format version, SNAPSHOT_VERSION
+    int recordSize;         ///< sizeof(struct Slot) of the writer
+    int userSize;           ///< sizeof(struct User) of the writer
+    int recordCount;        ///< Number of records
+    int userCount;          ///< Number of users
+    int generation;         ///< Last rotated log covered by the snapshot
+    long long usersBytes;   ///< Bytes of the users file covered by the users
+    int shardCount;         ///< Number of shards
+    int shardRecords[MAX_SHARDS]; ///< Number of records of each shard
+};
+
+static char *mapping;               ///< Snapshot mapped by readSnapshotRecords
+static size_t mappingSize;          ///< Size of the mapping in bytes
+static pid_t snapshotPid;           ///< Child writing a snapshot, 0 when none
+static int snapshotGeneration;      ///< Generation the running snapshot covers
+static pthread_mutex_t snapshotLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Write a whole buffer to a file
+ * @return 0 on success, 1 on error
+ */
+static int writeAll(int fd, const void *data, size_t length)
+{
+    const char *p = data;
+    while (length > 0)
+    {
+        ssize_t n = write(fd, p, length);
+        if (n <= 0)
+            return 1;
+        p += n;
+        length -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Read a whole buffer from a file
+ * @return 0 on success, 1 on error or early end of file
+ */
+static int readAll(int fd, void *data, size_t length)
+{
+    char *p = data;
+    while (length > 0)
+    {
+        ssize_t n = read(fd, p, length);
+        if (n <= 0)
+            return 1;
+        p += n;
+        length -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write a snapshot, only with system calls so it can run in a forked child
+ * @return 0 on success, 1 on error
+ */
+static int writeSnapshot(const struct Slot *const *records, const int *counts, int shards,
+                         const struct User *users, int userCount, long long usersBytes, int generation)
+{
+    char header[SNAPSHOT_HEADER_SIZE] = {0};
+    struct SnapshotHeader *h = (struct SnapshotHeader *)header;
+    int fd;
+
+    memcpy(h->magic, SNAPSHOT_MAGIC, 4);
+    h->version = SNAPSHOT_VERSION;
+    h->recordSize = sizeof(struct Slot);
+    h->userSize = sizeof(struct User);
+    h->userCount = userCount;
+    h->generation = generation;
+    h->usersBytes = usersBytes;
+    h->shardCount = shards;
+    for (int k = 0; k < shards; k++)
+    {
+        for (int slot = 0; slot < counts[k]; slot++)
+        {
+            h->shardRecords[k] += records[k][slot].id != DEAD_RECORD;
+        }
+        h->recordCount += h->shardRecords[k];
+    }
+
+    if ((fd = open("./data/snapshot.tmp", O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1)
+        return 1;
+    int failed = writeAll(fd, header, sizeof(header));
+
+    // write the live records in runs between tombstones
+    for (int k = 0; k < shards; k++)
+    {
+        for (int slot = 0; slot < counts[k] && !failed;)
+        {
+            int end = slot;
+            while (end < counts[k] && records[k][end].id != DEAD_RECORD)
+            {
+                end++;
+            }
+            failed = writeAll(fd, &records[k][slot], (size_t)(end - slot) * sizeof(struct Slot));
+            slot = end + 1;
+        }
+    }
+    if (!failed)
+        failed = writeAll(fd, users, (size_t)userCount * sizeof(struct User));
+    for (int pool = 0; pool < INTERN_POOLS && !failed; pool++)
+    {
+        const char *block;
+        size_t used;
+        long long length = 0;
+        for (int b = 0; (block = internBlock(pool, b, &used)) != NULL; b++)
+        {
+            length += used;
+        }
+        failed = writeAll(fd, &length, sizeof(length));
+        for (int b = 0; !failed && (block = internBlock(pool, b, &used)) != NULL; b++)
+        {
+            failed = writeAll(fd, block, used);
+        }
+    }
+    failed |= fsync(fd) != 0;
+    failed |= close(fd) != 0;
+    return failed || rename("./data/snapshot.tmp", SNAPSHOT) != 0;
+}
+
+/**
+ * @brief Start writing a snapshot of the records and users
+ *
+ * Must be called with every shard locked exclusively, right after the log
+ * was rotated, so the snapshot holds exactly the changes of the logs up to
+ * that generation. The locks also keep the string pools from growing.
+ *
+ * @param slots Record slots of each shard, tombstones are skipped
+ * @param counts Number of slots of each shard
+ * @param shards Number of shards
+ * @param generation Generation of the log rotated for this snapshot
+ */
+void startSnapshot(const struct Slot *const *slots, const int *counts, int shards, int generation)
+{
+    const struct User *users;
+    int userCount;
+    long long usersBytes;
+
+    pthread_mutex_lock(&snapshotLock);
+    lockUsers();
+    users = userTable(&userCount, &usersBytes);
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(writeSnapshot(slots, counts, shards, users, userCount, usersBytes, generation));
+    if (pid < 0)
+    {
+        // no child, so write it here and block for the time it takes
+        if (writeSnapshot(slots, counts, shards, users, userCount, usersBytes, generation) == 0)
+            removeRotatedLogs(generation);
+    }
+    unlockUsers();
+
+    if (pid > 0)
+    {
+        snapshotPid = pid;
+        snapshotGeneration = generation;
+    }
+    pthread_mutex_unlock(&snapshotLock);
+}
+
+/**
+ * @brief Check whether a snapshot is being written
+ *
+ * Reaps the child once it is done. A finished snapshot makes the rotated
+ * logs it covers useless, so they are removed; after a failed one they
+ * stay until a later snapshot covers them.
+ *
+ * @return 1 while a child is writing a snapshot, 0 otherwise
+ */
+int snapshotRunning(void)
+{
+    int status;
+    int running = 0;
+
+    pthread_mutex_lock(&snapshotLock);
+    if (snapshotPid != 0)
+    {
+        pid_t pid = waitpid(snapshotPid, &status, WNOHANG);
+        if (pid == 0)
+        {
+            running = 1;
+        }
+        else
+        {
+            if (pid == snapshotPid && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+                removeRotatedLogs(snapshotGeneration);
+            snapshotPid = 0;
+        }
+    }
+    pthread_mutex_unlock(&snapshotLock);
+    return running;
+}
+
+/**
+ * @brief Wait for the snapshot being written, if any
+ */
+void waitSnapshot(void)
+{
+    int status;
+
+    pthread_mutex_lock(&snapshotLock);
+    if (snapshotPid != 0 && waitpid(snapshotPid, &status, 0) == snapshotPid &&
+        WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        removeRotatedLogs(snapshotGeneration);
+    snapshotPid = 0;
+    pthread_mutex_unlock(&snapshotLock);
+}
+
+/**
+ * @brief Open the snapshot and check its header
+ *
+ * @return The descriptor, positioned past the header, or -1 without a usable snapshot
+ */
+static int openSnapshot(struct SnapshotHeader *h)
+{
+    char header[SNAPSHOT_HEADER_SIZE];
+    int fd;
+
+    if ((fd = open(SNAPSHOT, O_RDONLY)) == -1)
+        return -1;
+    if (readAll(fd, header, sizeof(header)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    memcpy(h, header, sizeof(*h));
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, 4) != 0 || h->version != SNAPSHOT_VERSION ||
+        h->recordSize != (int)sizeof(struct Slot) || h->userSize != (int)sizeof(struct User) ||
+        h->shardCount < 1 || h->shardCount > MAX_SHARDS)
+    {
+        printf("Error! %s was written by an incompatible build\n", SNAPSHOT);
+        exit(1);
+    }
+    return fd;
+}
+
+/**
+ * @brief Load the string pools that follow the users of the snapshot
+ *
+ * The pools must be empty, so every string gets back the id it was saved with.
+ */
+static void readPools(int fd, const struct SnapshotHeader *h)
+{
+    off_t offset = SNAPSHOT_HEADER_SIZE + (off_t)h->recordCount * h->recordSize + (off_t)h->userCount * h->userSize;
+
+    if (lseek(fd, offset, SEEK_SET) == -1)
+    {
+        printf("Error! reading %s", SNAPSHOT);
+        exit(1);
+    }
+    for (int pool = 0; pool < INTERN_POOLS; pool++)
+    {
+        long long length;
+        char *bytes = NULL;
+        if (readAll(fd, &length, sizeof(length)) != 0 || length < 0 ||
+            (bytes = malloc(length + 1)) == NULL || readAll(fd, bytes, length) != 0)
+        {
+            printf("Error! reading %s", SNAPSHOT);
+            exit(1);
+        }
+        internLoad(pool, bytes, length);
+        free(bytes);
+    }
+}
+
+/**
+ * @brief Load the records of the snapshot
+ *
+ * The slots are not read but mapped privately: the pages come straight
+ * from the page cache and are only copied when a slot is changed. The
+ * slots have no room to grow; the store moves each shard to its own
+ * memory before adding to it, and calls releaseSnapshotRecords once no
+ * shard uses them.
+ *
+ * The string pools must be empty; they are filled with the strings the
+ * slots refer to.
+ *
+ * @param slots Receives the slots of each shard
+ * @param counts Receives the number of records of each shard, which is also its capacity
+ * @param shards Number of shards of the store, the snapshot must have as many
+ * @param generation Receives the last rotated log the snapshot covers
+ * @return 1 if the snapshot was loaded, 0 if there is none
+ */
+int readSnapshotRecords(struct Slot **slots, int *counts, int shards, int *generation)
+{
+    struct SnapshotHeader h;
+    struct stat st;
+    int fd = openSnapshot(&h);
+
+    if (fd == -1)
+        return 0;
+    if (h.shardCount != shards)
+    {
+        printf("Error! %s holds %d shards, the store has %d\n", SNAPSHOT, h.shardCount, shards);
+        exit(1);
+    }
+    mappingSize = SNAPSHOT_HEADER_SIZE + (size_t)h.recordCount * h.recordSize;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < mappingSize ||
+        (mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0)) == MAP_FAILED)
+    {
+        printf("Error! reading %s", SNAPSHOT);
+        exit(1);
+    }
+
+    struct Slot *next = (struct Slot *)(mapping + SNAPSHOT_HEADER_SIZE);
+    readPools(fd, &h);
+    close(fd);
+    for (int k = 0; k < shards; k++)
+    {
+        slots[k] = next;
+        counts[k] = h.shardRecords[k];
+        next += h.shardRecords[k];
+    }
+    *generation = h.generation;
+    return 1;
+}
+
+/**
+ * @brief Release the slots loaded by readSnapshotRecords
+ */
+void releaseSnapshotRecords(void)
+{
+    if (mapping != NULL)
+        munmap(mapping, mappingSize);
+    mapping = NULL;
+}
+
+/**
+ * @brief Load the users of the snapshot
+ *
+ * @param count Receives the number of users
+ * @param usersBytes Receives the bytes of the users file they cover
+ * @return The users, NULL if there is no snapshot
+ */
+struct User *readSnapshotUsers(int *count, long long *usersBytes)
+{
+    struct SnapshotHeader h;
+    struct User *users;
+    int fd = openSnapshot(&h);
+
+    if (fd == -1)
+        return NULL;
+    if ((users = malloc(((size_t)h.userCount + 1) * sizeof(struct User))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    if (lseek(fd, (off_t)h.recordCount * h.recordSize, SEEK_CUR) == -1 ||
+        readAll(fd, users, (size_t)h.userCount * sizeof(struct User)) != 0)
+    {
+        printf("Error! reading %s", SNAPSHOT);
+        exit(1);
+    }
+    close(fd);
+    *count = h.userCount;
+    *usersBytes = h.usersBytes;
+    return users;
+}
+
+/**
+ * @brief Remove the snapshot once the text files hold every change again
+ */
+void removeSnapshot(void)
+{
+    waitSnapshot();
+    remove(SNAPSHOT);
+}
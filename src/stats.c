@@ -0,0 +1,287 @@
+/**
+ * @file stats.c
+ * @brief Operation statistics of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * Every account and user operation counts its calls and failures, the
+ * bytes it reads and writes and its latency. Latencies go into a
+ * log-linear histogram: each power of two of nanoseconds is split into
+ * STATS_SUB_BUCKETS buckets, so any percentile is known within 1/16 of
+ * its value over the whole range, from nanoseconds to minutes.
+ *
+ * Threads record into one of STATS_SHARDS shards picked when they first
+ * record, with relaxed atomic adds, so recording costs two clock reads
+ * and a few uncontended additions. Reports add the shards up.
+ *
+ * The operations no longer touch the files to read, so bytes read count
+ * the records and users an operation reads from memory; bytes written
+ * count what it appends to the transaction log and the users file.
+ */
+
+#include "header.h"
+#include <time.h>
+
+const char *STATS_FILE = "./data/stats.txt";
+
+#define STATS_SHARDS 16         ///< Shards the threads record into
+#define STATS_SUB_BITS 4        ///< log2 of the buckets per power of two
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BITS)
+#define STATS_MAX_BITS 40       ///< Latencies of 2^40 ns (18 minutes) or more share the last bucket
+#define STATS_BUCKETS ((STATS_MAX_BITS - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS)
+
+/**
+ * @brief Statistics of one operation in one shard
+ */
+struct OpStats
+{
+    unsigned long long count;           ///< Calls
+    unsigned long long errors;          ///< Calls that did not return OP_OK
+    unsigned long long bytesRead;       ///< Bytes read
+    unsigned long long bytesWritten;    ///< Bytes written
+    unsigned long long totalNanos;      ///< Sum of the latencies
+    unsigned long long maxNanos;        ///< Longest latency
+    unsigned long long buckets[STATS_BUCKETS]; ///< Latency histogram
+};
+
+static const char *opNames[STAT_OPS] = {
+    [STAT_CREATE] = "create",
+    [STAT_UPDATE] = "update",
+    [STAT_CHECK] = "check",
+    [STAT_LIST] = "list",
+    [STAT_TRANSACT] = "transact",
+    [STAT_REMOVE] = "remove",
+    [STAT_TRANSFER] = "transfer",
+    [STAT_MOVE] = "move",
+    [STAT_TRANSFER_ALL] = "transferall",
+    [STAT_LOGIN] = "login",
+    [STAT_REGISTER] = "register",
+    [STAT_CHECKPOINT] = "checkpoint",
+};
+
+static struct OpStats shards[STATS_SHARDS][STAT_OPS];
+static unsigned int nextShard;
+static __thread struct OpStats *threadStats;   ///< Shard of the calling thread
+static __thread int currentOp = -1;            ///< Operation the calling thread is in
+
+/**
+ * @brief Get a monotonic timestamp in nanoseconds
+ */
+long long statsNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Get the histogram bucket of a latency
+ */
+static int bucketOf(unsigned long long nanos)
+{
+    if (nanos < STATS_SUB_BUCKETS)
+        return nanos;
+    int bits = 63 - __builtin_clzll(nanos);
+    if (bits >= STATS_MAX_BITS)
+        return STATS_BUCKETS - 1;
+    int sub = (nanos >> (bits - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1);
+    return (bits - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS + sub;
+}
+
+/**
+ * @brief Get the smallest latency of a histogram bucket
+ */
+static unsigned long long bucketStart(int bucket)
+{
+    if (bucket < STATS_SUB_BUCKETS)
+        return bucket;
+    int bits = bucket / STATS_SUB_BUCKETS + STATS_SUB_BITS - 1;
+    return (unsigned long long)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << (bits - STATS_SUB_BITS);
+}
+
+/**
+ * @brief Get the statistics of an operation in the calling thread's shard
+ */
+static struct OpStats *opStats(int op)
+{
+    if (threadStats == NULL)
+        threadStats = shards[__atomic_fetch_add(&nextShard, 1, __ATOMIC_RELAXED) % STATS_SHARDS];
+    return &threadStats[op];
+}
+
+/**
+ * @brief Add to a counter shared with the other threads of the shard
+ */
+static void add(unsigned long long *counter, unsigned long long value)
+{
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Start timing an operation
+ *
+ * The bytes the calling thread reads and writes until statsEnd are
+ * counted for this operation.
+ *
+ * @param op STAT_* operation
+ * @return Start time to pass to statsEnd
+ */
+long long statsBegin(int op)
+{
+    currentOp = op;
+    return statsNow();
+}
+
+/**
+ * @brief Record the end of an operation
+ *
+ * @param op Operation passed to statsBegin
+ * @param start Time returned by statsBegin
+ * @param result OP_* result of the operation
+ */
+void statsEnd(int op, long long start, int result)
+{
+    unsigned long long nanos = statsNow() - start;
+    struct OpStats *s = opStats(op);
+    unsigned long long max = __atomic_load_n(&s->maxNanos, __ATOMIC_RELAXED);
+
+    add(&s->count, 1);
+    if (result != OP_OK)
+        add(&s->errors, 1);
+    add(&s->totalNanos, nanos);
+    add(&s->buckets[bucketOf(nanos)], 1);
+    while (nanos > max && !__atomic_compare_exchange_n(&s->maxNanos, &max, nanos, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+    currentOp = -1;
+}
+
+/**
+ * @brief Count bytes read by the operation of the calling thread
+ */
+void statsRead(long bytes)
+{
+    if (currentOp >= 0)
+        add(&opStats(currentOp)->bytesRead, bytes);
+}
+
+/**
+ * @brief Count bytes written by the operation of the calling thread
+ */
+void statsWritten(long bytes)
+{
+    if (currentOp >= 0)
+        add(&opStats(currentOp)->bytesWritten, bytes);
+}
+
+/**
+ * @brief Get a percentile of a histogram in microseconds
+ *
+ * @param buckets Histogram
+ * @param count Number of latencies in the histogram
+ * @param fraction Percentile as a fraction, 0.99 for p99
+ * @param max Longest latency in nanoseconds
+ * @return The middle of the bucket holding the percentile, at most max
+ */
+static double percentile(const unsigned long long *buckets, unsigned long long count, double fraction,
+                         unsigned long long max)
+{
+    if (count == 0)
+        return 0;
+
+    unsigned long long rank = (unsigned long long)(fraction * (count - 1)) + 1;
+    unsigned long long seen = 0;
+
+    for (int b = 0; b < STATS_BUCKETS; b++)
+    {
+        seen += buckets[b];
+        if (seen >= rank)
+        {
+            unsigned long long end = b + 1 < STATS_BUCKETS ? bucketStart(b + 1) : bucketStart(b);
+            unsigned long long middle = (bucketStart(b) + end) / 2;
+            return (middle < max ? middle : max) / 1e3;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Write one line of statistics per operation
+ *
+ * Each line is the operation name followed by name=value fields:
+ * count, errors, mean, p50, p90, p99, p999 and max latencies in
+ * microseconds, then bytes read and written.
+ *
+ * @param out Stream receiving the lines
+ * @return Number of lines written
+ */
+int writeStats(FILE *out)
+{
+    unsigned long long buckets[STATS_BUCKETS];
+
+    for (int op = 0; op < STAT_OPS; op++)
+    {
+        struct OpStats total = {0};
+
+        memset(buckets, 0, sizeof(buckets));
+        for (int i = 0; i < STATS_SHARDS; i++)
+        {
+            const struct OpStats *s = &shards[i][op];
+            total.count += __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+            total.errors += __atomic_load_n(&s->errors, __ATOMIC_RELAXED);
+            total.bytesRead += __atomic_load_n(&s->bytesRead, __ATOMIC_RELAXED);
+            total.bytesWritten += __atomic_load_n(&s->bytesWritten, __ATOMIC_RELAXED);
+            total.totalNanos += __atomic_load_n(&s->totalNanos, __ATOMIC_RELAXED);
+            unsigned long long max = __atomic_load_n(&s->maxNanos, __ATOMIC_RELAXED);
+            if (max > total.maxNanos)
+                total.maxNanos = max;
+            for (int b = 0; b < STATS_BUCKETS; b++)
+            {
+                buckets[b] += __atomic_load_n(&s->buckets[b], __ATOMIC_RELAXED);
+            }
+        }
+
+        // the counters are read one by one, so the histogram may hold a few calls more
+        unsigned long long counted = 0;
+        for (int b = 0; b < STATS_BUCKETS; b++)
+        {
+            counted += buckets[b];
+        }
+        fprintf(out, "%s count=%llu errors=%llu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p999=%.1f max=%.1f read=%llu written=%llu\n",
+                opNames[op],
+                total.count,
+                total.errors,
+                total.count ? total.totalNanos / 1e3 / total.count : 0,
+                percentile(buckets, counted, 0.5, total.maxNanos),
+                percentile(buckets, counted, 0.9, total.maxNanos),
+                percentile(buckets, counted, 0.99, total.maxNanos),
+                percentile(buckets, counted, 0.999, total.maxNanos),
+                total.maxNanos / 1e3,
+                total.bytesRead,
+                total.bytesWritten);
+    }
+    return STAT_OPS;
+}
+
+/**
+ * @brief Write the statistics to STATS_FILE
+ */
+void saveStats(void)
+{
+    FILE *fp;
+
+    if ((fp = fopen(STATS_FILE, "w")) == NULL)
+        return;
+    writeStats(fp);
+    fclose(fp);
+}
+
+/**
+ * @brief Forget every statistic recorded so far
+ *
+ * Must not run while other threads record.
+ */
+void resetStats(void)
+{
+    memset(shards, 0, sizeof(shards));
+}
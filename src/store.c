@@ -0,0 +1,1628 @@
+/**
+ * @file store.c
+ * @brief In-memory account store for the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * The records are split into shards by a hash of the account number. Each
+ * shard is loaded once into its own array of record slots, from the latest
+ * snapshot when there is one, otherwise from its own records file. A hash
+ * index keyed by account number maps every account of a shard to its
+ * slot, so the account operations look a record up in constant time
+ * instead of rescanning the records file. A second index keyed by owner id
+ * lists the slots of each user's accounts in the shard.
+ *
+ * A deleted account leaves a tombstone in its slot, so a delete moves no
+ * other record and ids never change. Compaction packs the live records of
+ * a shard once tombstones make up a large enough share of its slots.
+ *
+ * Changes are persisted by appending them to the transaction log, which
+ * all shards share so their changes join the same group commits. A
+ * checkpoint rotates the log and writes a snapshot of every shard in the
+ * background; the records files are only rewritten by --to-text,
+ * --to-binary and --reshard. When the binary store is in use, every change
+ * is also written in place to its mapping.
+ *
+ * A slot is a struct Slot rather than a struct Record: the owner name and
+ * country are interned, see intern.c, and the account type is parsed into
+ * its code, so an account takes 40 bytes instead of more than 200. Records
+ * are packed on the way in and unpacked on the way out, with their type
+ * code set, so the rest of the bank only sees struct Record.
+ *
+ * The number of shards is read from SHARDS_FILE, one when it is missing.
+ * A single shard keeps its records in RECORDS; otherwise shard k of n
+ * keeps them in ./data/records.k-of-n.txt. Loading, rewriting and
+ * compacting the shards run in parallel, one thread per shard.
+ *
+ * The store itself takes no locks; account.c gives each shard its own
+ * lock and serializes access to it.
+ */
+
+#include "header.h"
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+extern const char *RECORDS;
+extern const char *LOG;
+extern const char *BINARY_RECORDS;
+
+const char *SHARDS_FILE = "./data/shards.txt";
+
+/**
+ * @brief Entry of the account index
+ *
+ * The account number is kept next to the slot so a probe never reads the
+ * record itself.
+ */
+struct IndexEntry
+{
+    int accountNbr;     ///< Account number of the slot
+    int slot;           ///< Slot of the account, -1 when the entry is empty
+};
+
+/**
+ * @brief Accounts of one owner in the owner index
+ */
+struct Owner
+{
+    int userId;     ///< Id of the owner
+    int count;      ///< Number of slots the owner has
+    int capacity;   ///< Number of allocated slots
+    int *slots;     ///< Slots of the owner's accounts, in increasing order
+};
+
+/**
+ * @brief Records and indexes of one shard
+ */
+struct Shard
+{
+    struct Slot *slots;         ///< Record slots, in file order
+    int recordCount;            ///< Number of used slots
+    int recordCapacity;         ///< Number of allocated slots
+    int snapshotSlots;          ///< Slots are mapped from the snapshot, with no room to grow
+    int deadCount;              ///< Slots holding a tombstone
+
+    struct IndexEntry *accountIndex;    ///< Open addressing table of accounts
+    int indexCapacity;                  ///< Size of the table, always a power of two
+
+    unsigned long long *accountFilter;  ///< Blocked Bloom filter over the indexed account numbers
+    int filterBlocks;                   ///< Number of 64-byte blocks, always a power of two
+
+    struct Owner *owners;       ///< Open addressing table of owners, slots NULL when empty
+    int ownerCount;             ///< Number of owners in the table
+    int ownerCapacity;          ///< Size of the table, always a power of two
+};
+
+static struct Shard shards[MAX_SHARDS];
+static int shardCount = 1;      ///< Number of shards in use
+static int mappedShards;        ///< Shards whose slots are still mapped from the snapshot
+static int binaryBackend;       ///< Changes are written to the binary store
+static struct Record *binaryRecords;    ///< Mapping of the binary store
+static int binaryCapacity;              ///< Records the mapping has room for
+static int checkpointEntries = LOG_CHECKPOINT_ENTRIES; ///< Log entries that trigger a checkpoint
+
+/**
+ * @brief Get the shard of an account number in a layout of some number of shards
+ */
+static int shardIndex(int accountNbr, int count)
+{
+    // the high bits of the hash pick the shard, the index and the stripes use the low ones
+    unsigned int h = (unsigned int)accountNbr * 2654435769u;
+    return (int)(((unsigned long long)h * count) >> 32);
+}
+
+/**
+ * @brief Get the shard holding an account number
+ */
+int shardOf(int accountNbr)
+{
+    return shardIndex(accountNbr, shardCount);
+}
+
+/**
+ * @brief Get the number of shards in use
+ */
+int storeShards(void)
+{
+    return shardCount;
+}
+
+/**
+ * @brief Get the records file of a shard
+ *
+ * @param path Receives the path
+ * @param size Size of path
+ * @param shard Shard of the layout
+ * @param count Number of shards of the layout
+ */
+static void shardPath(char *path, size_t size, int shard, int count)
+{
+    if (count == 1)
+        snprintf(path, size, "%s", RECORDS);
+    else
+        snprintf(path, size, "./data/records.%d-of-%d.txt", shard, count);
+}
+
+/**
+ * @brief Read the number of shards from SHARDS_FILE
+ */
+static int readShardCount(void)
+{
+    FILE *fp;
+    int count = 1;
+
+    if ((fp = fopen(SHARDS_FILE, "r")) == NULL)
+        return 1;
+    if (fscanf(fp, "%d", &count) != 1 || count < 1 || count > MAX_SHARDS)
+    {
+        printf("Error! %s does not hold a shard count between 1 and %d", SHARDS_FILE, MAX_SHARDS);
+        exit(1);
+    }
+    fclose(fp);
+    return count;
+}
+
+/**
+ * @brief Work of one thread started by runParallel
+ */
+struct ShardJob
+{
+    void (*fn)(int shard, void *arg);
+    void *arg;
+    int shard;
+};
+
+/**
+ * @brief Thread running one shard job
+ */
+static void *shardThread(void *arg)
+{
+    struct ShardJob *job = arg;
+    job->fn(job->shard, job->arg);
+    return NULL;
+}
+
+/**
+ * @brief Call a function for shards 0 to count - 1, each in its own thread
+ *
+ * A shard whose thread cannot be started runs on the calling thread.
+ */
+static void runParallel(int count, void (*fn)(int shard, void *arg), void *arg)
+{
+    pthread_t tid[MAX_SHARDS];
+    struct ShardJob jobs[MAX_SHARDS];
+    int started[MAX_SHARDS];
+
+    if (count == 1)
+    {
+        fn(0, arg);
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        jobs[i].fn = fn;
+        jobs[i].arg = arg;
+        jobs[i].shard = i;
+        started[i] = pthread_create(&tid[i], NULL, shardThread, &jobs[i]) == 0;
+        if (!started[i])
+            fn(i, arg);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (started[i])
+            pthread_join(tid[i], NULL);
+    }
+}
+
+/**
+ * @brief Call a function for every shard, each in its own thread
+ *
+ * @param fn Function called with the shard number and arg
+ * @param arg Argument passed to fn
+ */
+void runOnShards(void (*fn)(int shard, void *arg), void *arg)
+{
+    runParallel(shardCount, fn, arg);
+}
+
+/**
+ * @brief Check whether a slot holds the tombstone of a deleted account
+ */
+static int isDead(const struct Shard *s, int slot)
+{
+    return s->slots[slot].id == DEAD_RECORD;
+}
+
+/**
+ * @brief Get the slot type of an account type name
+ *
+ * Known types are stored as their code; any other name is interned so it
+ * survives the round trip, and stored past TYPE_UNKNOWN.
+ */
+static unsigned short packType(const char *accountType)
+{
+    int type = accountTypeCode(accountType);
+    if (type != TYPE_UNKNOWN)
+        return type;
+
+    unsigned int id = intern(POOL_TYPES, accountType);
+    if (id > USHRT_MAX - TYPE_UNKNOWN)
+    {
+        printf("Error! more than %d unknown account types", USHRT_MAX - TYPE_UNKNOWN + 1);
+        exit(1);
+    }
+    return TYPE_UNKNOWN + id;
+}
+
+/**
+ * @brief Pack a record into a slot, parsing its type and interning its strings
+ */
+static void packRecord(const struct Record *r, struct Slot *slot)
+{
+    slot->id = r->id;
+    slot->userId = r->userId;
+    slot->accountNbr = r->accountNbr;
+    slot->phone = r->phone;
+    slot->amount = r->amount;
+    slot->name = intern(POOL_NAMES, r->name);
+    slot->country = intern(POOL_COUNTRIES, r->country);
+    slot->year = r->deposit.year;
+    slot->month = r->deposit.month;
+    slot->day = r->deposit.day;
+    slot->type = packType(r->accountType);
+}
+
+/**
+ * @brief Unpack a slot into a record, with no withdraw date
+ */
+static void unpackRecord(const struct Slot *slot, struct Record *r)
+{
+    r->id = slot->id;
+    r->userId = slot->userId;
+    r->accountNbr = slot->accountNbr;
+    r->phone = slot->phone;
+    r->amount = slot->amount;
+    strcpy(r->name, internString(POOL_NAMES, slot->name));
+    strcpy(r->country, internString(POOL_COUNTRIES, slot->country));
+    if (slot->type < TYPE_UNKNOWN)
+    {
+        strcpy(r->accountType, accountTypes[slot->type].name);
+        r->type = slot->type;
+    }
+    else
+    {
+        strcpy(r->accountType, internString(POOL_TYPES, slot->type - TYPE_UNKNOWN));
+        r->type = TYPE_UNKNOWN;
+    }
+    r->deposit.year = slot->year;
+    r->deposit.month = slot->month;
+    r->deposit.day = slot->day;
+    r->withdraw.year = r->withdraw.month = r->withdraw.day = 0;
+}
+
+/**
+ * @brief Hash an account number into the index table
+ */
+static unsigned int hashAccount(const struct Shard *s, int accountNbr)
+{
+    // Fibonacci hashing spreads sequential account numbers across the table
+    return ((unsigned int)accountNbr * 2654435769u) & (s->indexCapacity - 1);
+}
+
+/**
+ * @brief Get the filter block and the four bits of an account number
+ *
+ * All four bits of a key fall in one 64-byte block, so a check costs a
+ * single cache line.
+ *
+ * @param bits Receives the four bit positions within the block
+ * @return The first word of the block
+ */
+static unsigned long long *filterBits(const struct Shard *s, int accountNbr, int bits[4])
+{
+    unsigned long long h = (unsigned int)accountNbr * 0x9E3779B97F4A7C15ull;
+    for (int k = 0; k < 4; k++)
+    {
+        bits[k] = (h >> (9 * k)) & 511;
+    }
+    return &s->accountFilter[((h >> 40) & (s->filterBlocks - 1)) * 8];
+}
+
+/**
+ * @brief Add an account number to the filter
+ */
+static void filterAdd(struct Shard *s, int accountNbr)
+{
+    int bits[4];
+    unsigned long long *block = filterBits(s, accountNbr, bits);
+    for (int k = 0; k < 4; k++)
+    {
+        block[bits[k] / 64] |= 1ull << (bits[k] % 64);
+    }
+}
+
+/**
+ * @brief Check whether an account number may be indexed
+ * @return 0 if the account is certainly not indexed, 1 if it may be
+ */
+static int filterMayContain(const struct Shard *s, int accountNbr)
+{
+    int bits[4];
+    unsigned long long *block = filterBits(s, accountNbr, bits);
+    for (int k = 0; k < 4; k++)
+    {
+        if (!(block[bits[k] / 64] & (1ull << (bits[k] % 64))))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Insert a slot into the index, assumes the table has room
+ */
+static void indexPut(struct Shard *s, int slot)
+{
+    int accountNbr = s->slots[slot].accountNbr;
+    unsigned int i = hashAccount(s, accountNbr);
+    while (s->accountIndex[i].slot != -1)
+    {
+        i = (i + 1) & (s->indexCapacity - 1);
+    }
+    s->accountIndex[i].accountNbr = accountNbr;
+    s->accountIndex[i].slot = slot;
+    filterAdd(s, accountNbr);
+}
+
+/**
+ * @brief Remove the entry at a table position
+ *
+ * Entries probed past the hole are shifted back into it, so lookups
+ * still find them and the table needs no deleted markers.
+ */
+static void indexRemove(struct Shard *s, int pos)
+{
+    int hole = pos;
+    int i = pos;
+
+    for (;;)
+    {
+        s->accountIndex[hole].slot = -1;
+        for (;;)
+        {
+            i = (i + 1) & (s->indexCapacity - 1);
+            if (s->accountIndex[i].slot == -1)
+                return;
+            // an entry whose home lies cyclically in (hole, i] must stay
+            int home = hashAccount(s, s->accountIndex[i].accountNbr);
+            if (hole <= i ? hole < home && home <= i : hole < home || home <= i)
+                continue;
+            s->accountIndex[hole] = s->accountIndex[i];
+            hole = i;
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Find the index position holding an account number
+ *
+ * Numbers that are not in use are usually turned away by the filter
+ * without probing the table.
+ *
+ * @return The table position, or -1 if the account is not indexed
+ */
+static int indexFind(const struct Shard *s, int accountNbr)
+{
+    if (s->indexCapacity == 0 || !filterMayContain(s, accountNbr))
+        return -1;
+
+    unsigned int i = hashAccount(s, accountNbr);
+    while (s->accountIndex[i].slot != -1)
+    {
+        if (s->accountIndex[i].accountNbr == accountNbr)
+            return i;
+        i = (i + 1) & (s->indexCapacity - 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief Rebuild the index so it holds every slot with a load factor under one half
+ *
+ * The filter is rebuilt with it, which also clears the bits of deleted accounts.
+ */
+static void rebuildIndex(struct Shard *s)
+{
+    int capacity = 16;
+    while (capacity < s->recordCount * 2)
+    {
+        capacity *= 2;
+    }
+    if (capacity != s->indexCapacity)
+    {
+        free(s->accountIndex);
+        free(s->accountFilter);
+        // 8 filter bits per table entry, at least 16 per account
+        s->filterBlocks = capacity >= 64 ? capacity / 64 : 1;
+        if ((s->accountIndex = malloc(capacity * sizeof(struct IndexEntry))) == NULL ||
+            (s->accountFilter = malloc(s->filterBlocks * 64)) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+        s->indexCapacity = capacity;
+    }
+    memset(s->accountIndex, -1, s->indexCapacity * sizeof(struct IndexEntry));
+    memset(s->accountFilter, 0, s->filterBlocks * 64);
+    s->deadCount = 0;
+    for (int slot = 0; slot < s->recordCount; slot++)
+    {
+        if (isDead(s, slot))
+            s->deadCount++;
+        else
+            indexPut(s, slot);
+    }
+}
+
+/**
+ * @brief Hash a user id into the owner table
+ */
+static unsigned int hashOwner(const struct Shard *s, int userId)
+{
+    return ((unsigned int)userId * 2654435769u) & (s->ownerCapacity - 1);
+}
+
+/**
+ * @brief Find the owner index entry of a user
+ *
+ * @param create 1 to add an empty entry when the user has none
+ * @return The entry, or NULL if the user has none and create is 0
+ */
+static struct Owner *ownerFind(struct Shard *s, int userId, int create)
+{
+    if (s->ownerCapacity == 0 || (create && (s->ownerCount + 1) * 2 > s->ownerCapacity))
+    {
+        if (!create)
+            return NULL;
+
+        // grow the table and move every owner to its new position
+        struct Owner *old = s->owners;
+        int oldCapacity = s->ownerCapacity;
+        s->ownerCapacity = s->ownerCapacity ? s->ownerCapacity * 2 : 16;
+        if ((s->owners = calloc(s->ownerCapacity, sizeof(struct Owner))) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+        for (int i = 0; i < oldCapacity; i++)
+        {
+            if (old[i].slots == NULL)
+                continue;
+            unsigned int j = hashOwner(s, old[i].userId);
+            while (s->owners[j].slots != NULL)
+            {
+                j = (j + 1) & (s->ownerCapacity - 1);
+            }
+            s->owners[j] = old[i];
+        }
+        free(old);
+    }
+
+    unsigned int i = hashOwner(s, userId);
+    while (s->owners[i].slots != NULL)
+    {
+        if (s->owners[i].userId == userId)
+            return &s->owners[i];
+        i = (i + 1) & (s->ownerCapacity - 1);
+    }
+    if (!create)
+        return NULL;
+
+    s->owners[i].userId = userId;
+    s->owners[i].count = 0;
+    s->owners[i].capacity = 4;
+    if ((s->owners[i].slots = malloc(4 * sizeof(int))) == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    s->ownerCount++;
+    return &s->owners[i];
+}
+
+/**
+ * @brief Add a slot to the accounts of its owner, keeping them in file order
+ */
+static void ownerAdd(struct Shard *s, int slot)
+{
+    struct Owner *o = ownerFind(s, s->slots[slot].userId, 1);
+    int i = o->count;
+
+    if (o->count == o->capacity)
+    {
+        o->capacity *= 2;
+        if ((o->slots = realloc(o->slots, o->capacity * sizeof(int))) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+    }
+    // new accounts are appended, so this loop only runs for transfers
+    while (i > 0 && o->slots[i - 1] > slot)
+    {
+        o->slots[i] = o->slots[i - 1];
+        i--;
+    }
+    o->slots[i] = slot;
+    o->count++;
+}
+
+/**
+ * @brief Add slots, in increasing order, to the accounts of an owner in one pass
+ */
+static void ownerMerge(struct Shard *s, int userId, const int *slots, int count)
+{
+    struct Owner *o = ownerFind(s, userId, 1);
+    int i = o->count - 1;
+    int j = count - 1;
+    int k = o->count + count - 1;
+
+    if (o->count + count > o->capacity)
+    {
+        while (o->count + count > o->capacity)
+        {
+            o->capacity *= 2;
+        }
+        if ((o->slots = realloc(o->slots, o->capacity * sizeof(int))) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+    }
+    // merge from the end, so no slot moves twice
+    while (j >= 0)
+    {
+        if (i >= 0 && o->slots[i] > slots[j])
+            o->slots[k--] = o->slots[i--];
+        else
+            o->slots[k--] = slots[j--];
+    }
+    o->count += count;
+}
+
+/**
+ * @brief Remove a slot from the accounts of an owner
+ */
+static void ownerRemove(struct Shard *s, int userId, int slot)
+{
+    struct Owner *o = ownerFind(s, userId, 0);
+    if (o == NULL)
+        return;
+
+    for (int i = 0; i < o->count; i++)
+    {
+        if (o->slots[i] == slot)
+        {
+            memmove(&o->slots[i], &o->slots[i + 1], (o->count - i - 1) * sizeof(int));
+            o->count--;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Rebuild the owner index from every slot
+ */
+static void rebuildOwners(struct Shard *s)
+{
+    for (int i = 0; i < s->ownerCapacity; i++)
+    {
+        s->owners[i].count = 0;
+    }
+    for (int slot = 0; slot < s->recordCount; slot++)
+    {
+        if (!isDead(s, slot))
+            ownerAdd(s, slot);
+    }
+}
+
+/**
+ * @brief Rebuild both indexes of a shard
+ */
+static void rebuildShard(int shard, void *arg)
+{
+    (void)arg;
+    rebuildIndex(&shards[shard]);
+    rebuildOwners(&shards[shard]);
+}
+
+/**
+ * @brief Append a slot, growing the slots when full
+ */
+static void appendSlot(struct Shard *s, const struct Slot *slot)
+{
+    if (binaryBackend && s->recordCount == binaryCapacity)
+    {
+        binaryCapacity = binaryCapacity ? binaryCapacity * 2 : 64;
+        binaryRecords = growBinaryStore(binaryCapacity);
+    }
+    if (s->recordCount == s->recordCapacity)
+    {
+        s->recordCapacity = s->recordCapacity ? s->recordCapacity * 2 : 64;
+        if (s->snapshotSlots)
+        {
+            struct Slot *copy = malloc(s->recordCapacity * sizeof(struct Slot));
+            if (copy == NULL)
+            {
+                printf("Error! out of memory");
+                exit(1);
+            }
+            memcpy(copy, s->slots, s->recordCount * sizeof(struct Slot));
+            s->slots = copy;
+            s->snapshotSlots = 0;
+            // the shards share the mapping, the last one to move out unmaps it
+            if (__atomic_sub_fetch(&mappedShards, 1, __ATOMIC_ACQ_REL) == 0)
+                releaseSnapshotRecords();
+        }
+        else if ((s->slots = realloc(s->slots, s->recordCapacity * sizeof(struct Slot))) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+    }
+    s->slots[s->recordCount++] = *slot;
+}
+
+/**
+ * @brief Append a record read by the bulk loader to the shard it was read for
+ */
+static void loadSlot(const struct Record *r, void *arg)
+{
+    struct Shard *s = arg;
+
+    if (&shards[shardOf(r->accountNbr)] != s)
+    {
+        printf("Error! account %d is in the records file of another shard", r->accountNbr);
+        exit(1);
+    }
+    struct Slot slot;
+    packRecord(r, &slot);
+    appendSlot(s, &slot);
+}
+
+/**
+ * @brief Load the records file of a shard and index it
+ */
+static void loadShard(int shard, void *arg)
+{
+    char path[64];
+
+    (void)arg;
+    shardPath(path, sizeof(path), shard, shardCount);
+    // a shard that never had an account has no file yet
+    if (loadRecordFile(path, loadSlot, &shards[shard]) < 0 && shardCount == 1)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    rebuildShard(shard, NULL);
+}
+
+/**
+ * @brief Insert or replace an account in memory
+ * @return The slot holding the account
+ */
+static int applyUpsert(struct Shard *s, const struct Record *r)
+{
+    struct Slot packed;
+    int pos = indexFind(s, r->accountNbr);
+
+    packRecord(r, &packed);
+    if (pos != -1)
+    {
+        int slot = s->accountIndex[pos].slot;
+        int oldOwner = s->slots[slot].userId;
+        s->slots[slot] = packed;
+        if (oldOwner != r->userId)
+        {
+            ownerRemove(s, oldOwner, slot);
+            ownerAdd(s, slot);
+        }
+        return slot;
+    }
+
+    appendSlot(s, &packed);
+    if (s->recordCount * 2 > s->indexCapacity)
+        rebuildIndex(s);
+    else
+        indexPut(s, s->recordCount - 1);
+    ownerAdd(s, s->recordCount - 1);
+    return s->recordCount - 1;
+}
+
+/**
+ * @brief Delete an account from memory
+ *
+ * The slot keeps a tombstone until the next compaction, so no other
+ * record moves and the delete costs O(1).
+ *
+ * @return The slot the account was in, or -1 if it does not exist
+ */
+static int applyDelete(struct Shard *s, int accountNbr)
+{
+    int pos = indexFind(s, accountNbr);
+    if (pos == -1)
+        return -1;
+
+    int slot = s->accountIndex[pos].slot;
+    indexRemove(s, pos);
+    ownerRemove(s, s->slots[slot].userId, slot);
+    s->slots[slot].id = DEAD_RECORD;
+    s->deadCount++;
+    return slot;
+}
+
+/**
+ * @brief Set the balance of an account in memory
+ * @return The slot of the account, or -1 if it does not exist
+ */
+static int applyBalance(struct Shard *s, int accountNbr, double amount)
+{
+    int pos = indexFind(s, accountNbr);
+    if (pos == -1)
+        return -1;
+
+    int slot = s->accountIndex[pos].slot;
+    s->slots[slot].amount = amount;
+    return slot;
+}
+
+/**
+ * @brief Give the accounts of an owner to another owner in memory
+ *
+ * The owner's slots are looked up in the owner index of every shard and
+ * moved to the new owner's in one merge, so the cost follows the number of
+ * accounts both owners have.
+ *
+ * @param accountType Only give accounts of this known type, NULL for all
+ * @param accounts Receives the numbers of the accounts given, to free
+ * @return Number of accounts given
+ */
+static int applyReassign(int fromId, const char *fromName, int toId, const char *toName, const char *accountType,
+                         int **accounts)
+{
+    unsigned int from;
+    unsigned int to = intern(POOL_NAMES, toName);
+    int type = accountType != NULL ? accountTypeCode(accountType) : -1;
+    int given = 0;
+
+    *accounts = NULL;
+    if (!internFind(POOL_NAMES, fromName, &from))
+        return 0;
+    for (int k = 0; k < shardCount; k++)
+    {
+        struct Shard *s = &shards[k];
+        struct Owner *o = ownerFind(s, fromId, 0);
+        if (o == NULL || o->count == 0)
+            continue;
+
+        // the new owner's entry may move the old owner's, so keep the given slots aside
+        int count = 0;
+        int kept = 0;
+        int *slots = malloc(o->count * sizeof(int));
+        if (slots == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+        for (int i = 0; i < o->count; i++)
+        {
+            struct Slot *slot = &s->slots[o->slots[i]];
+            if (slot->name == from && (type == -1 || slot->type == type))
+            {
+                slot->userId = toId;
+                slot->name = to;
+                slots[count++] = o->slots[i];
+            }
+            else
+            {
+                o->slots[kept++] = o->slots[i];
+            }
+        }
+        o->count = kept;
+        if (count > 0)
+        {
+            ownerMerge(s, toId, slots, count);
+            if ((*accounts = realloc(*accounts, (size_t)(given + count) * sizeof(int))) == NULL)
+            {
+                printf("Error! out of memory");
+                exit(1);
+            }
+            for (int i = 0; i < count; i++)
+            {
+                (*accounts)[given + i] = s->slots[slots[i]].accountNbr;
+            }
+        }
+        free(slots);
+        given += count;
+    }
+    return given;
+}
+
+/**
+ * @brief Give some accounts to an owner in memory, as a replayed log entry does
+ *
+ * Accounts that no longer exist are skipped and the owner indexes of the
+ * shards touched are rebuilt, so replaying the entry again is harmless.
+ */
+static void applyOwners(int toId, const char *toName, const int *accounts, int count)
+{
+    unsigned int to = intern(POOL_NAMES, toName);
+    char touched[MAX_SHARDS] = {0};
+
+    for (int i = 0; i < count; i++)
+    {
+        int k = shardOf(accounts[i]);
+        int pos = indexFind(&shards[k], accounts[i]);
+        if (pos == -1)
+            continue;
+        struct Slot *slot = &shards[k].slots[shards[k].accountIndex[pos].slot];
+        slot->userId = toId;
+        slot->name = to;
+        touched[k] = 1;
+    }
+    for (int k = 0; k < shardCount; k++)
+    {
+        if (touched[k])
+            rebuildOwners(&shards[k]);
+    }
+}
+
+/**
+ * @brief Keep the record id counter past every loaded record
+ */
+static void reserveRecordIds(void)
+{
+    int last = -1;
+    for (int k = 0; k < shardCount; k++)
+    {
+        for (int slot = 0; slot < shards[k].recordCount; slot++)
+        {
+            if (shards[k].slots[slot].id > last)
+                last = shards[k].slots[slot].id;
+        }
+    }
+    reserveId(ID_RECORD, last);
+}
+
+/**
+ * @brief Apply every complete entry of a log to the records in memory
+ *
+ * @param end Receives the offset just past the last complete entry
+ * @return Number of entries applied
+ */
+static int replayLog(FILE *fp, long *end)
+{
+    struct Record r;
+    struct Record to;
+    int *accounts = NULL;
+    char op;
+    int entries = 0;
+
+    *end = 0;
+    while (getLogEntry(fp, &op, &r, &to, &accounts))
+    {
+        struct Shard *s = &shards[shardOf(r.accountNbr)];
+        if (op == 'U')
+        {
+            applyUpsert(s, &r);
+        }
+        else if (op == 'M')
+        {
+            applyBalance(s, r.accountNbr, r.amount);
+            applyBalance(&shards[shardOf(to.accountNbr)], to.accountNbr, to.amount);
+        }
+        else if (op == 'O')
+        {
+            applyOwners(to.userId, to.name, accounts, r.accountNbr);
+        }
+        else
+        {
+            applyDelete(s, r.accountNbr);
+        }
+        entries++;
+        *end = ftell(fp);
+    }
+    free(accounts);
+    return entries;
+}
+
+/**
+ * @brief Compact a shard if it has enough tombstones
+ */
+static void compactIfDue(int shard, void *arg)
+{
+    (void)arg;
+    if (compactionDue(shard))
+        compactRecords(shard);
+}
+
+/**
+ * @brief Load every record into memory and replay the transaction logs
+ *
+ * The records come from the snapshot when there is one, otherwise from the
+ * records files, one thread per shard. The rotated logs the snapshot does
+ * not cover are replayed next, then the current log.
+ *
+ * Must be called before any other store function.
+ */
+void loadRecords(void)
+{
+    FILE *fp;
+    struct Slot *mapped[MAX_SHARDS];
+    int counts[MAX_SHARDS];
+    int generations[MAX_ROTATED_LOGS];
+    int generation = 0;
+    int entries = 0;
+    long end = 0;
+
+    // a reload drops the slots of the previous load
+    for (int k = 0; k < shardCount; k++)
+    {
+        if (shards[k].snapshotSlots)
+        {
+            shards[k].slots = NULL;
+            shards[k].recordCapacity = 0;
+            shards[k].snapshotSlots = 0;
+        }
+        shards[k].recordCount = 0;
+    }
+    if (mappedShards > 0)
+        releaseSnapshotRecords();
+    mappedShards = 0;
+    internReset();
+    shardCount = readShardCount();
+
+    if (binaryStoreExists())
+    {
+        if (shardCount != 1)
+        {
+            printf("Error! the binary store holds a single shard, remove %s", SHARDS_FILE);
+            exit(1);
+        }
+        int count;
+        binaryBackend = 1;
+        binaryRecords = openBinaryStore(&count, &binaryCapacity);
+        for (int slot = 0; slot < count; slot++)
+        {
+            struct Slot packed;
+            packRecord(&binaryRecords[slot], &packed);
+            appendSlot(&shards[0], &packed);
+        }
+        rebuildShard(0, NULL);
+        reserveRecordIds();
+        compactIfDue(0, NULL);
+        internSettle();
+        return;
+    }
+
+    if (readSnapshotRecords(mapped, counts, shardCount, &generation))
+    {
+        for (int k = 0; k < shardCount; k++)
+        {
+            shards[k].slots = mapped[k];
+            shards[k].recordCount = shards[k].recordCapacity = counts[k];
+            shards[k].snapshotSlots = 1;
+        }
+        mappedShards = shardCount;
+        runOnShards(rebuildShard, NULL);
+    }
+    else
+    {
+        runOnShards(loadShard, NULL);
+    }
+
+    // rotated logs the snapshot covers are left over from a crash
+    removeRotatedLogs(generation);
+    int count = rotatedLogs(generations, MAX_ROTATED_LOGS);
+    for (int i = 0; i < count; i++)
+    {
+        if ((fp = openRotatedLog(generations[i])) != NULL)
+        {
+            replayLog(fp, &end);
+            fclose(fp);
+        }
+        generation = generations[i];
+    }
+    if ((fp = fopen(LOG, "r")) != NULL)
+    {
+        entries = replayLog(fp, &end);
+        fclose(fp);
+    }
+    else
+    {
+        end = 0;
+    }
+
+    reserveRecordIds();
+    openLog(entries, end, generation);
+    runOnShards(compactIfDue, NULL);
+    internSettle();
+}
+
+/**
+ * @brief Write the live records of one shard of a layout to its records file
+ *
+ * The file is synced before it replaces the old one.
+ *
+ * @param shard Shard of the layout to write
+ * @param arg Number of shards of the layout
+ */
+static void writeShardFile(int shard, void *arg)
+{
+    int count = *(const int *)arg;
+    char path[64];
+    char temp[80];
+    FILE *fp;
+
+    shardPath(path, sizeof(path), shard, count);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    if ((fp = fopen(temp, "w")) == NULL)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    for (int k = 0; k < shardCount; k++)
+    {
+        const struct Shard *s = &shards[k];
+        // in the current layout only the shard itself holds its records
+        if (count == shardCount && k != shard)
+            continue;
+        for (int slot = 0; slot < s->recordCount; slot++)
+        {
+            if (!isDead(s, slot) && (count == shardCount || shardIndex(s->slots[slot].accountNbr, count) == shard))
+            {
+                struct Record r;
+                unpackRecord(&s->slots[slot], &r);
+                saveAccountToFile(fp, &r);
+            }
+        }
+    }
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+    {
+        printf("Error! writing file");
+        exit(1);
+    }
+    fclose(fp);
+    rename(temp, path);
+}
+
+/**
+ * @brief Rewrite the records files from memory, one thread per shard
+ */
+void saveRecords(void)
+{
+    runOnShards(writeShardFile, &shardCount);
+}
+
+/**
+ * @brief Rotate the log and start a snapshot of the state it leads to
+ *
+ * Must be called with every shard locked exclusively. The snapshot is
+ * written in the background, see snapshot.c.
+ */
+void checkpointRecords(void)
+{
+    const struct Slot *slots[MAX_SHARDS];
+    int counts[MAX_SHARDS];
+
+    for (int k = 0; k < shardCount; k++)
+    {
+        slots[k] = shards[k].slots;
+        counts[k] = shards[k].recordCount;
+    }
+    startSnapshot(slots, counts, shardCount, rotateLog());
+}
+
+/**
+ * @brief Rebuild the string pools from the strings the live slots use
+ *
+ * Must be called with every shard locked exclusively. Tombstones keep
+ * their old ids, they are never read again.
+ */
+void reclaimStrings(void)
+{
+    internRebuildBegin();
+    for (int k = 0; k < shardCount; k++)
+    {
+        struct Shard *s = &shards[k];
+        for (int slot = 0; slot < s->recordCount; slot++)
+        {
+            if (isDead(s, slot))
+                continue;
+            struct Slot *p = &s->slots[slot];
+            p->name = internRemap(POOL_NAMES, p->name);
+            p->country = internRemap(POOL_COUNTRIES, p->country);
+            if (p->type >= TYPE_UNKNOWN)
+                p->type = TYPE_UNKNOWN + internRemap(POOL_TYPES, p->type - TYPE_UNKNOWN);
+        }
+    }
+    internRebuildEnd();
+}
+
+/**
+ * @brief Rewrite the records files and drop the snapshot and the logs they make useless
+ */
+static void foldIntoRecordsFile(void)
+{
+    saveRecords();
+    // without the snapshot, replaying the logs over the new records files is harmless
+    removeSnapshot();
+    truncateLog();
+    removeRotatedLogs(INT_MAX);
+}
+
+/**
+ * @brief Convert the records between the text files and the binary store
+ *
+ * @param toBinary 1 to create the binary store, 0 to go back to the text files
+ */
+void convertRecords(int toBinary)
+{
+    loadRecords();
+    if (toBinary && !binaryBackend)
+    {
+        if (shardCount != 1)
+        {
+            printf("Error! the binary store holds a single shard, run --reshard 1 first");
+            exit(1);
+        }
+        foldIntoRecordsFile();
+        compactRecords(0);
+
+        struct Record *records = malloc(((size_t)shards[0].recordCount + 1) * sizeof(struct Record));
+        if (records == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+        for (int slot = 0; slot < shards[0].recordCount; slot++)
+        {
+            unpackRecord(&shards[0].slots[slot], &records[slot]);
+        }
+        createBinaryStore(records, shards[0].recordCount);
+        free(records);
+    }
+    else if (!toBinary && binaryBackend)
+    {
+        saveRecords();
+        remove(LOG);
+        closeBinaryStore();
+        remove(BINARY_RECORDS);
+    }
+    else if (!toBinary)
+    {
+        foldIntoRecordsFile();
+    }
+}
+
+/**
+ * @brief Write the number of shards to SHARDS_FILE
+ */
+static void writeShardCount(int count)
+{
+    FILE *temp;
+
+    if ((temp = fopen("./data/shards.tmp", "w")) == NULL)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    fprintf(temp, "%d\n", count);
+    if (fflush(temp) != 0 || fsync(fileno(temp)) != 0)
+    {
+        printf("Error! writing file");
+        exit(1);
+    }
+    fclose(temp);
+    rename("./data/shards.tmp", SHARDS_FILE);
+}
+
+/**
+ * @brief Split the records into a new number of shards
+ *
+ * The logs and the snapshot are first folded into the records files of
+ * the current shards, then the files of the new layout are written next
+ * to them. Until the new count replaces the old one in SHARDS_FILE the
+ * old files hold every account, and from then on the new ones do, so a
+ * crash at any point loses nothing.
+ *
+ * @param count New number of shards, 1 to MAX_SHARDS
+ */
+void reshardRecords(int count)
+{
+    char path[64];
+
+    if (count < 1 || count > MAX_SHARDS)
+    {
+        printf("Error! the number of shards must be between 1 and %d\n", MAX_SHARDS);
+        exit(1);
+    }
+    loadRecords();
+    if (binaryBackend)
+    {
+        printf("Error! run --to-text before resharding the binary store\n");
+        exit(1);
+    }
+    foldIntoRecordsFile();
+    if (count == shardCount)
+        return;
+
+    runParallel(count, writeShardFile, &count);
+    writeShardCount(count);
+    for (int k = 0; k < shardCount; k++)
+    {
+        shardPath(path, sizeof(path), k, shardCount);
+        remove(path);
+    }
+}
+
+/**
+ * @brief Set how many log entries trigger a checkpoint
+ */
+void setCheckpointInterval(int entries)
+{
+    checkpointEntries = entries;
+}
+
+/**
+ * @brief Check whether the transaction log is long enough for a checkpoint
+ */
+int checkpointDue(void)
+{
+    return !binaryBackend && logSize() >= checkpointEntries && !snapshotRunning();
+}
+
+/**
+ * @brief Check whether enough slots of a shard hold tombstones for a compaction
+ *
+ * Compaction is due once COMPACT_MIN_DEAD tombstones make up more than a
+ * quarter of the slots.
+ */
+int compactionDue(int shard)
+{
+    const struct Shard *s = &shards[shard];
+    return s->deadCount >= COMPACT_MIN_DEAD && s->deadCount * 4 > s->recordCount;
+}
+
+/**
+ * @brief Drop the tombstones of a shard and pack its live records together
+ *
+ * Records keep their ids; only their slots change, so both indexes are
+ * rebuilt. On the binary store the packed records are written back and
+ * synced before the new count in the header.
+ */
+void compactRecords(int shard)
+{
+    struct Shard *s = &shards[shard];
+    int kept = 0;
+
+    for (int slot = 0; slot < s->recordCount; slot++)
+    {
+        if (isDead(s, slot))
+            continue;
+        if (kept != slot)
+            s->slots[kept] = s->slots[slot];
+        kept++;
+    }
+    s->recordCount = kept;
+    if (binaryBackend)
+    {
+        for (int slot = 0; slot < kept; slot++)
+        {
+            unpackRecord(&s->slots[slot], &binaryRecords[slot]);
+        }
+        syncBinaryStore(binaryRecords, (size_t)kept * sizeof(struct Record), kept);
+    }
+    rebuildShard(shard, NULL);
+}
+
+/**
+ * @brief Persist one change
+ *
+ * @param op Change type, 'U' or 'D'
+ * @param r Changed record
+ * @param s Shard the change was applied to
+ * @param slot Slot the change was applied to
+ */
+static void commitChange(char op, const struct Record *r, const struct Shard *s, int slot)
+{
+    if (binaryBackend)
+    {
+        unpackRecord(&s->slots[slot], &binaryRecords[slot]);
+        syncBinaryStore(&binaryRecords[slot], sizeof(struct Record), s->recordCount);
+        return;
+    }
+
+    appendLog(op, r);
+}
+
+/**
+ * @brief Look an account up by its number
+ *
+ * @param accountNbr Account number to find
+ * @param r Receives a copy of the record when found, may be NULL
+ * @return 1 if the account exists, 0 otherwise
+ */
+int findAccount(int accountNbr, struct Record *r)
+{
+    const struct Shard *s = &shards[shardOf(accountNbr)];
+    int pos = indexFind(s, accountNbr);
+    if (pos == -1)
+        return 0;
+    if (r != NULL)
+        unpackRecord(&s->slots[s->accountIndex[pos].slot], r);
+    return 1;
+}
+
+/**
+ * @brief Look an account up by its number, only if the user owns it
+ *
+ * @param u User who must own the account
+ * @param accountNbr Account number to find
+ * @param r Receives a copy of the record when found
+ * @return 1 if the account exists and belongs to the user, 0 otherwise
+ */
+int findUserAccount(struct User u, int accountNbr, struct Record *r)
+{
+    struct Record cr;
+    if (!findAccount(accountNbr, &cr) || strcmp(cr.name, u.name) != 0)
+        return 0;
+    *r = cr;
+    return 1;
+}
+
+/**
+ * @brief Call a function for every account owned by a user, shard by shard in file order
+ *
+ * Uses the owner indexes, so the cost follows the number of accounts the
+ * user owns rather than the size of the book.
+ */
+void forEachUserAccount(struct User u, void (*fn)(const struct Record *, void *), void *arg)
+{
+    struct Record r;
+    unsigned int name;
+
+    // accounts hold the interned name, so a user whose name is not interned has none
+    if (!internFind(POOL_NAMES, u.name, &name))
+        return;
+    for (int k = 0; k < shardCount; k++)
+    {
+        struct Shard *s = &shards[k];
+        struct Owner *o = ownerFind(s, u.id, 0);
+        if (o == NULL)
+            continue;
+
+        for (int i = 0; i < o->count; i++)
+        {
+            const struct Slot *slot = &s->slots[o->slots[i]];
+            if (slot->name == name)
+            {
+                unpackRecord(slot, &r);
+                fn(&r, arg);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Get the number of used slots of a shard, tombstones included
+ */
+int shardSlots(int shard)
+{
+    return shards[shard].recordCount;
+}
+
+/**
+ * @brief Call a function for every account in a range of slots of one shard
+ *
+ * @param from First slot
+ * @param to Slot past the last one
+ */
+void forEachAccountInSlots(int shard, int from, int to, void (*fn)(const struct Record *, void *), void *arg)
+{
+    const struct Shard *s = &shards[shard];
+    struct Record r;
+
+    for (int slot = from; slot < to && slot < s->recordCount; slot++)
+    {
+        if (!isDead(s, slot))
+        {
+            unpackRecord(&s->slots[slot], &r);
+            fn(&r, arg);
+        }
+    }
+}
+
+/**
+ * @brief Call a function for every account of one shard, in file order
+ */
+void forEachShardAccount(int shard, void (*fn)(const struct Record *, void *), void *arg)
+{
+    forEachAccountInSlots(shard, 0, shards[shard].recordCount, fn, arg);
+}
+
+/**
+ * @brief Call a function for every account, shard by shard in file order
+ */
+void forEachAccount(void (*fn)(const struct Record *, void *), void *arg)
+{
+    for (int k = 0; k < shardCount; k++)
+    {
+        forEachShardAccount(k, fn, arg);
+    }
+}
+
+/**
+ * @brief Append a new account and log it
+ * @return 0 on success, 1 if the account number is already used
+ */
+int insertAccount(const struct Record *r)
+{
+    struct Shard *s = &shards[shardOf(r->accountNbr)];
+    if (indexFind(s, r->accountNbr) != -1)
+        return 1;
+
+    commitChange('U', r, s, applyUpsert(s, r));
+    return 0;
+}
+
+/**
+ * @brief Replace the stored account having the same account number and log it
+ * @return 0 on success, 1 if the account does not exist
+ */
+int updateAccount(const struct Record *r)
+{
+    struct Shard *s = &shards[shardOf(r->accountNbr)];
+    if (indexFind(s, r->accountNbr) == -1)
+        return 1;
+
+    commitChange('U', r, s, applyUpsert(s, r));
+    return 0;
+}
+
+/**
+ * @brief Set the balance of an account and log it
+ *
+ * On the binary store only the 8 bytes of the balance are written.
+ *
+ * @return 0 on success, 1 if the account does not exist
+ */
+int updateBalance(int accountNbr, double amount)
+{
+    struct Shard *s = &shards[shardOf(accountNbr)];
+    struct Record r;
+    int slot = applyBalance(s, accountNbr, amount);
+    if (slot == -1)
+        return 1;
+
+    if (binaryBackend)
+    {
+        binaryRecords[slot].amount = amount;
+        syncBinaryStore(&binaryRecords[slot].amount, sizeof(double), s->recordCount);
+    }
+    else
+    {
+        unpackRecord(&s->slots[slot], &r);
+        commitChange('U', &r, s, slot);
+    }
+    return 0;
+}
+
+/**
+ * @brief Set the balances of both sides of a move and log them in one entry
+ *
+ * The single entry makes the move atomic across a crash. The binary store
+ * has no log: there both balances are written in place, one after the other.
+ *
+ * @return 0 on success, 1 if either account does not exist
+ */
+int moveBalance(int fromNbr, double fromAmount, int toNbr, double toAmount)
+{
+    struct Shard *s = &shards[shardOf(fromNbr)];
+    struct Shard *t = &shards[shardOf(toNbr)];
+    if (indexFind(s, fromNbr) == -1 || indexFind(t, toNbr) == -1)
+        return 1;
+
+    int from = applyBalance(s, fromNbr, fromAmount);
+    int to = applyBalance(t, toNbr, toAmount);
+    if (binaryBackend)
+    {
+        binaryRecords[from].amount = fromAmount;
+        binaryRecords[to].amount = toAmount;
+        syncBinaryStore(&binaryRecords[from].amount, sizeof(double), s->recordCount);
+        syncBinaryStore(&binaryRecords[to].amount, sizeof(double), t->recordCount);
+    }
+    else
+    {
+        appendMove(fromNbr, fromAmount, toNbr, toAmount);
+    }
+    return 0;
+}
+
+/**
+ * @brief Give every account of an owner, or those of one type, to another owner and log it
+ *
+ * One entry logs the whole change, with the number of every account given,
+ * so it is replayed whole or not at all, and sets the same owners however
+ * often it is replayed. Must be called with every shard locked exclusively. The binary store has
+ * no log: there the given records are written in place and synced at once.
+ *
+ * @param accountType Only give accounts of this known type, NULL for all
+ * @return Number of accounts given
+ */
+int reassignAccounts(int fromId, const char *fromName, int toId, const char *toName, const char *accountType)
+{
+    int *accounts;
+    int given = applyReassign(fromId, fromName, toId, toName, accountType, &accounts);
+    if (given == 0)
+        return 0;
+
+    if (!binaryBackend)
+    {
+        appendReassign(toId, toName, accounts, given);
+        free(accounts);
+        return given;
+    }
+    free(accounts);
+    // the new owner's slots are in file order, so one sync covers them all
+    struct Shard *s = &shards[0];
+    struct Owner *o = ownerFind(s, toId, 0);
+    for (int i = 0; i < o->count; i++)
+    {
+        unpackRecord(&s->slots[o->slots[i]], &binaryRecords[o->slots[i]]);
+    }
+    int first = o->slots[0];
+    syncBinaryStore(&binaryRecords[first], (size_t)(o->slots[o->count - 1] - first + 1) * sizeof(struct Record), s->recordCount);
+    return given;
+}
+
+/**
+ * @brief Delete an account and log it
+ * @return 0 on success, 1 if the account does not exist
+ */
+int deleteAccount(int accountNbr)
+{
+    struct Shard *s = &shards[shardOf(accountNbr)];
+    struct Record r;
+
+    int slot = applyDelete(s, accountNbr);
+    if (slot == -1)
+        return 1;
+
+    r.accountNbr = accountNbr;
+    commitChange('D', &r, s, slot);
+    return 0;
+}
+
+/**
+ * @brief Get the bytes allocated for the slots, the indexes and the string pools
+ */
+size_t storeMemory(void)
+{
+    size_t bytes = internMemory(NULL);
+
+    for (int k = 0; k < shardCount; k++)
+    {
+        const struct Shard *s = &shards[k];
+        bytes += (size_t)s->recordCapacity * sizeof(struct Slot);
+        bytes += (size_t)s->indexCapacity * sizeof(struct IndexEntry) + (size_t)s->filterBlocks * 64;
+        bytes += (size_t)s->ownerCapacity * sizeof(struct Owner);
+        for (int i = 0; i < s->ownerCapacity; i++)
+        {
+            bytes += (size_t)s->owners[i].capacity * sizeof(int);
+        }
+    }
+    return bytes;
+}
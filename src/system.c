@@ -13,9 +13,12 @@
 #include <ctype.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
 #include <stdbool.h>
 
 const char *RECORDS = "./data/records.txt";
+const char *DATA_LOCK = "./data/atm.lock";
 
 #include <stdbool.h>
 bool fileExists(const char *path);
@@ -33,16 +36,36 @@ void ensureDirectoryExists(const char *path) {
     }
 }
 
+/**
+ * @brief Lock the data directory for this process
+ *
+ * The store keeps its state in memory and appends to the log at its own
+ * offset, so only one process may use ./data at a time. The lock is held
+ * until the process exits; a second process refuses to start.
+ */
+static void lockDataDirectory(void) {
+    static int lockFd = -1;
+
+    if (lockFd != -1)
+        return;
+    lockFd = open(DATA_LOCK, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd == -1 || flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+        printf("Error! ./data is in use by another atm process\n");
+        exit(1);
+    }
+}
+
 /**
  * @brief Initialize the system
  * 
  * This function initializes the system by creating necessary directories
- * and files if they don't exist.
+ * and files if they don't exist, and locks the data directory.
  * 
  * @return true if initialization was successful
  */
 void initSystem() {
     ensureDirectoryExists("./data");
+    lockDataDirectory();
     
     // Create users file if it doesn't exist
     if (!fileExists("./data/users.txt")) {
@@ -52,8 +75,8 @@ void initSystem() {
         }
     }
     
-    // Create records file if it doesn't exist
-    if (!fileExists("./data/records.txt")) {
+    // Create records file if it doesn't exist, sharded records have one file per shard
+    if (!fileExists("./data/records.txt") && !fileExists("./data/shards.txt")) {
         FILE *fp = fopen("./data/records.txt", "w");
         if (fp) {
             fclose(fp);
@@ -82,30 +105,11 @@ bool fileExists(const char *path) {
 void createNewAcc(struct User u)
 {
     struct Record r;
-    struct Record cr;
     char initial[100];
-    char userName[50];
-    int count = 0;
-    char c;
-    FILE *pf;
-
-    system("clear");
-    if ((pf = fopen(RECORDS, "a+")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
 
+    clearScreen();
     printf("\t\t\t===== New record =====\n");
 
-    while (getAccountFromFile(pf, &cr))
-    {
-        //loop till we reach the last value
-    }
-    count = cr.id;
-    rewind(pf);
-    r.id = count + 1;
-
 validDate:
     printf("\nEnter today's date(mm/dd/yyyy):");
     fgets(initial,50,stdin);
@@ -134,13 +138,9 @@ validAccount:
         goto validAccount;
     }
 
-    while (getAccountFromFile(pf, &cr))
+    if (accountTaken(r.accountNbr))
     {
-        if (cr.accountNbr == r.accountNbr)
-        {
-            fclose(pf);
-            stayOrReturn(0, "This Account number is already used", createNewAcc, u);
-        }
+        stayOrReturn(0, "This Account number is already used", createNewAcc, u);
     }
 
 validCountry:
@@ -187,7 +187,11 @@ validAmount:
     }
 
 validAccountType:
-    printf("\nChoose the type of account:\n\t-> saving\n\t-> current\n\t-> fixed01(for 1 year)\n\t-> fixed02(for 2 years)\n\t-> fixed03(for 3 years)\n\n\tEnter your choice:");
+    printf("\nChoose the type of account:");
+    for (int type = 0; type < TYPE_UNKNOWN; type++) {
+        printf("\n\t-> %s%s", accountTypes[type].name, accountTypes[type].label);
+    }
+    printf("\n\n\tEnter your choice:");
     fgets(initial,50,stdin);
     checkBuffer(initial);
     if (checkValidAccount(initial) != 0)
@@ -199,17 +203,32 @@ validAccountType:
     r.accountType[sizeof(r.accountType) - 1] = '\0';
 
 
-    r.userId = u.id;
-    strncpy(r.name, u.name, sizeof(r.name) - 1);
-    r.name[sizeof(r.name) - 1] = '\0';
-    toLowerCase(r.accountType);
-
-    saveAccountToFile(pf, &r);
-
-    fclose(pf);
+    int result = openAccount(u, &r);
+    if (result != OP_OK)
+    {
+        stayOrReturn(0, opMessage(result), createNewAcc, u);
+    }
     success(u);
 }
 
+/**
+ * @brief Print one owned account of the list screen
+ */
+static void printOwnedAccount(const struct Record *r, void *arg)
+{
+    (void)arg;
+    printf("_____________________\n");
+    printf("\nAccount number:%d\nDeposit Date:%d/%d/%d \ncountry:%s \nPhone number:%d \nAmount deposited: $%.2f \nType Of Account:%s\n",
+           r->accountNbr,
+           r->deposit.day,
+           r->deposit.month,
+           r->deposit.year,
+           r->country,
+           r->phone,
+           r->amount,
+           r->accountType);
+}
+
 /**
  * @brief Display the main menu for the user
  * 
@@ -217,35 +236,9 @@ validAccountType:
  */
 void checkAllAccounts(struct User u)
 {
-    char userName[100];
-    struct Record r;
-    FILE *pf;
-
-    if ((pf = fopen(RECORDS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-
-    system("clear");
+    clearScreen();
     printf("\t\t====== All accounts from user, %s =====\n\n", u.name);
-    while (getAccountFromFile(pf, &r))
-    {
-        if (strcmp(r.name, u.name) == 0)
-        {
-            printf("_____________________\n");
-            printf("\nAccount number:%d\nDeposit Date:%d/%d/%d \ncountry:%s \nPhone number:%d \nAmount deposited: $%.2f \nType Of Account:%s\n",
-                   r.accountNbr,
-                   r.deposit.day,
-                   r.deposit.month,
-                   r.deposit.year,
-                   r.country,
-                   r.phone,
-                   r.amount,
-                   r.accountType);
-        }
-    }
-    fclose(pf);
+    listAccounts(u, printOwnedAccount, NULL);
     success(u);
 }
 
@@ -261,15 +254,8 @@ void updateInfo(struct User u)
     int account;
     int checker = 0;
     char buffer[100];
-    FILE *curr, *temp;
 
-
-    system("clear");
-    if ((curr = fopen(RECORDS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
+    clearScreen();
 invalid:
     printf("\t\t What is the account number you want to change ?\n");
     fgets(buffer,100,stdin);
@@ -282,24 +268,12 @@ invalid:
     }
         sscanf(buffer,"%d", &account);
 
-    while (getAccountFromFile(curr, &cr))
+    if (getAccount(u, account, &cr) != OP_OK)
     {
-        if (strcmp(cr.name, u.name) == 0 && cr.accountNbr == account)
-        {
-            checker = 1;
-            break;
-        }
-    }
-
-    rewind(curr);
-    if (checker == 0)
-    {
-    fclose(curr);
     stayOrReturn(0, "This account does not exist",updateInfo,u);
 
     }
 
-    checker = 0;
 validOption:
     printf("\tWhich information do you want?\n ");
     printf("\t 1-> phone number\n");
@@ -355,31 +329,11 @@ enterCountry:
         break;
     }
 
-    if ((temp = fopen("./data/temp.txt", "w")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-
-    while (getAccountFromFile(curr, &cr))
+    int result = changeAccountInfo(u, account, phone, checker == 0 ? buffer : NULL);
+    if (result != OP_OK)
     {
-        if (strcmp(cr.name, u.name) == 0 && cr.accountNbr == account)
-        {
-            if(checker == 0) {
-                strncpy(cr.country, buffer, sizeof(cr.country) - 1);
-                cr.country[sizeof(cr.country) - 1] = '\0';
-            } else {
-                cr.phone = phone;
-            }
-        }
-        saveAccountToFile(temp, &cr);
+        stayOrReturn(0, opMessage(result), updateInfo, u);
     }
-
-    fclose(curr);
-    fclose(temp);
-    remove(RECORDS);
-    rename("./data/temp.txt", RECORDS);
-
     success(u);
 }
 
@@ -391,17 +345,10 @@ enterCountry:
 void removeAccount(struct User u)
 {
     struct Record cr;
-    FILE *curr, *temp;
-    int checker = 0;
     char buffer[100];
     int account;
 
-    system("clear");
-    if ((curr = fopen(RECORDS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
+    clearScreen();
 enterAccount:
     printf("\t Enter the account you want to delete :");
     fgets(buffer,100,stdin);
@@ -415,23 +362,12 @@ enterAccount:
 
     sscanf(buffer,"%d",&account);
 
-    while (getAccountFromFile(curr, &cr))
-    {
-        if (strcmp(cr.name, u.name) == 0 && cr.accountNbr == account)
-        {
-            checker = 1;
-            break;
-        }
-    }
-
-    rewind(curr);
-    if (checker == 0)
+    if (getAccount(u, account, &cr) != OP_OK)
     {
-        fclose(curr);
         stayOrReturn(0, "There is no account of this record", removeAccount, u);
 
     }
-    system("clear");
+    clearScreen();
     printf("\t\t====== Deleted account ======\n\n");
     printf("\tAccount number:%d\n", cr.accountNbr);
     printf("\tCountry:%s\n", cr.country);
@@ -439,30 +375,10 @@ enterAccount:
     printf("\tAmount deposited:%.2f\n", cr.amount);
     printf("\tType Of Account:%s\n\n", cr.accountType);
 
-    if ((temp = fopen("./data/temp.txt", "w")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-    checker = 0;
-    while (getAccountFromFile(curr, &cr))
+    if (closeAccount(u, account, NULL) != OP_OK)
     {
-        if (checker == 1)
-        {
-            cr.id = cr.id - 1;
-        }
-        if (strcmp(cr.name, u.name) == 0 && cr.accountNbr == account)
-        {
-            checker = 1;
-            continue;
-        }
-        saveAccountToFile(temp, &cr);
+        stayOrReturn(0, "There is no account of this record", removeAccount, u);
     }
-
-    fclose(curr);
-    fclose(temp);
-    remove(RECORDS);
-    rename("./data/temp.txt", RECORDS);
     success(u);
 }
 
@@ -474,17 +390,10 @@ enterAccount:
 void checkDetails(struct User u)
 {
     struct Record cr;
-    FILE *fp;
     char buffer[100];
     int account;
-    int checker = 0;
 
-    system("clear");
-    if ((fp = fopen(RECORDS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
+    clearScreen();
 validAccount:
     printf("\tEnter the account number: ");
     fgets(buffer,100,stdin);
@@ -498,22 +407,12 @@ validAccount:
 
     sscanf(buffer,"%d", &account);
 
-    while(getAccountFromFile(fp, &cr))
+    if (getAccount(u, account, &cr) != OP_OK)
     {
-        if (strcmp(cr.name, u.name) == 0 && cr.accountNbr == account)
-        {
-            checker = 1;
-            break;
-        }
-    }
-    rewind(fp);
-    if (checker == 0)
-    {
-        fclose(fp);
         stayOrReturn(0, "This account does not exist", checkDetails, u);
     }
 
-    system("clear");
+    clearScreen();
     printf("\n\tAccount number:%d\n", cr.accountNbr);
     printf("\tDeposit Date:%d/%d/%d\n", cr.deposit.day,cr.deposit.month,cr.deposit.year);
     printf("\tCountry:%s\n", cr.country);
@@ -521,35 +420,26 @@ validAccount:
     printf("\tAmount deposited:%.2f\n", cr.amount);
     printf("\tType Of Account:%s\n\n", cr.accountType);
 
-    float value;
-    if (strcmp(cr.accountType, "saving") == 0)
+    const struct AccountType *type = &accountTypes[cr.type];
+    float value = accountInterest(cr.type, cr.amount);
+    if (cr.type == TYPE_UNKNOWN)
     {
-        value = (cr.amount * 0.07) / 12;
-        printf("\tYou will get $%.2f as interest on day %d of every month", value, cr.deposit.day);
-    } else if (strcmp(cr.accountType, "current") == 0)
-    {
-        printf("\tYou will not get interests because the account is of type current");
-    } else if (strcmp(cr.accountType, "fixed01") == 0)
-    {
-        value = cr.amount * 0.04;
-        printf("\tYou will get $%.2f as interest on  %d/%d/%d", value, cr.deposit.day,cr.deposit.month,cr.deposit.year + 1);
-    } else if (strcmp(cr.accountType, "fixed02") == 0)
+        printf("\tYour account %s is not known and will be treated as current\n", cr.accountType);
+    } else if (type->payout == PAYOUT_MONTHLY)
     {
-        value = (cr.amount * 0.05) * 2;
-        printf("\tYou will get $%.2f as interest on  %d/%d/%d", value, cr.deposit.day,cr.deposit.month,cr.deposit.year + 2);
-    } else if (strcmp(cr.accountType, "fixed03") == 0)
+        printf("\tYou will get $%.2f as interest on day %d of every month", value, cr.deposit.day);
+    } else if (type->payout == PAYOUT_AT_TERM)
     {
-        value = (cr.amount * 0.08) * 3;
-        printf("\tYou will get $%.2f as interest on  %d/%d/%d", value, cr.deposit.day,cr.deposit.month,cr.deposit.year + 3);
+        printf("\tYou will get $%.2f as interest on  %d/%d/%d", value, cr.deposit.day,cr.deposit.month,cr.deposit.year + (int)type->years);
     } else
     {
-        printf("\tYour account %s is not known and will be treated as current\n", cr.accountType);
+        printf("\tYou will not get interests because the account is of type %s", type->name);
     }
     success(u);
 }
 
 /**
- * @brief Make a transaction (deposit or withdraw) on an account
+ * @brief Make a transaction (deposit, withdraw or transfer to another account) on an account
  * 
  * @param u User information
  */
@@ -557,13 +447,12 @@ void makeTransaction(struct User u)
 {
     char buffer[100];
     struct Record cr;
-    FILE *fp, *temp;
     int option;
     int account;
     double amount;
-    int checker = 0;
+    int target = 0;
 
-    system("clear");
+    clearScreen();
 validac:
     printf("\tEnter your account number:");
     fgets(buffer,100,stdin);
@@ -576,34 +465,17 @@ validac:
     }
     sscanf(buffer,"%d", &account);
 
-
-    if ((fp = fopen(RECORDS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-    while(getAccountFromFile(fp, &cr))
-    {
-        if (strcmp(cr.name, u.name) == 0 && cr.accountNbr == account)
-        {
-            checker = 1;
-            break;
-        }
-    }
-    rewind(fp);
-    if (checker == 0) {
-        fclose(fp);
+    if (getAccount(u, account, &cr) != OP_OK) {
         stayOrReturn(0,"No account with that account number", makeTransaction, u);
     }
 
-    if (strcmp(cr.accountType, "fixed01") == 0 || strcmp(cr.accountType, "fixed02") == 0 || strcmp(cr.accountType, "fixed03") == 0)
+    if (!accountTypes[cr.type].transactable)
     {
-        fclose(fp);
         stayOrReturn(0,"Cannot make transcations on fixed accounts", makeTransaction, u);
     }
 
 option:
-    printf("\tDo you want to\n\t\t1-> Deposit\n\t\t2-> Withdraw\n");
+    printf("\tDo you want to\n\t\t1-> Deposit\n\t\t2-> Withdraw\n\t\t3-> Transfer to another account\n");
     fgets(buffer,100,stdin);
     checkBuffer(buffer);
 
@@ -614,12 +486,26 @@ option:
     }
     sscanf(buffer,"%d", &option);
 
-    if (option != 1 && option != 2)
+    if (option != 1 && option != 2 && option != 3)
     {
         printf("\tPlease pick a valid option\n");
         goto option;
         //redo the option
     }
+validTarget:
+    if (option == 3)
+    {
+        printf("\tEnter the account number to transfer to:");
+        fgets(buffer,100,stdin);
+        checkBuffer(buffer);
+
+        if(checkValidType(buffer, "int")!= 0)
+        {
+            printf("\t\nPlease enter a valid account number\n\n");
+            goto validTarget;
+        }
+        sscanf(buffer,"%d", &target);
+    }
 Amount:
     printf("\tEnter the amount: $");
     fgets(buffer,100,stdin);
@@ -632,33 +518,47 @@ Amount:
     }
     sscanf(buffer,"%lf", &amount);
 
-    if (option == 2 && amount > cr.amount){
-        fclose(fp);
-        stayOrReturn(0,"Not enough money to make this transcation", makeTransaction, u);
-    }
-    if ((temp = fopen("./data/temp.txt", "w")) == NULL)
+    int result = option == 3 ? moveFunds(u, account, target, amount, NULL)
+                             : transact(u, account, option == 1 ? amount : -amount, NULL);
+    if (result != OP_OK)
     {
-        printf("Error! opening file");
-        exit(1);
+        stayOrReturn(0, opMessage(result), makeTransaction, u);
     }
-    while(getAccountFromFile(fp, &cr))
+    success(u);
+
+}
+
+/**
+ * @brief Transfer ownership of every account, or of those of one type
+ *
+ * @param u User information
+ */
+static void transferAll(struct User u)
+{
+    char buffer[100];
+    char username[50];
+    int given;
+
+    printf("\tOnly accounts of one type? Enter the type, or leave empty for all: ");
+    fgets(buffer,100,stdin);
+    checkBuffer(buffer);
+    toLowerCase(buffer);
+    if (buffer[0] != '\0' && checkValidAccount(buffer) != 0)
     {
-        if (strcmp(cr.name, u.name) == 0 && cr.accountNbr == account) {
-            if (option == 1) {
-                cr.amount = cr.amount + amount;
-            } else if (option == 2) {
-                cr.amount = cr.amount - amount;
-            }
-        }
-        saveAccountToFile(temp, &cr);
+        stayOrReturn(0, "This account type does not exist", transferOwner, u);
     }
-    fclose(fp);
-    fclose(temp);
-    remove(RECORDS);
-    rename("./data/temp.txt", RECORDS);
 
-    success(u);
+    printf("\tWhich user you want to transfer ownership to (user name): ");
+    scanf("%49s", username);
+    clearStdin();
 
+    int result = giveAllAccounts(u, username, buffer[0] != '\0' ? buffer : NULL, &given);
+    if (result != OP_OK)
+    {
+        stayOrReturn(0, opMessage(result), transferOwner, u);
+    }
+    printf("\n\t%d account(s) transferred\n", given);
+    success(u);
 }
 
 /**
@@ -668,22 +568,23 @@ Amount:
  */
 void transferOwner(struct User u)
 {
-    const char *USERS = "./data/users.txt";
     struct Record r;
-    struct User p;
-    FILE *curr, *temp, *user;
-    int checker = 0;
     int account;
     char buffer[100];
     char username[50];
-    int userId = 0;
 
-    system("clear");
+    clearScreen();
 validAcc:
-    printf("\tEnter the account number you want to transfer ownership: ");
+    printf("\tEnter the account number you want to transfer ownership, or \"all\": ");
     fgets(buffer,100,stdin);
     checkBuffer(buffer);
 
+    if (strcmp(buffer, "all") == 0)
+    {
+        transferAll(u);
+        return;
+    }
+
     if(checkValidType(buffer, "int")!= 0)
     {
         printf("\t\nPlease enter a valid account number\n\n");
@@ -691,22 +592,8 @@ validAcc:
     }
     sscanf(buffer,"%d", &account);
 
-    if ((curr = fopen(RECORDS, "r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-    while (getAccountFromFile(curr, &r))
+    if (getAccount(u, account, &r) != OP_OK)
     {
-        if (strcmp(u.name, r.name) == 0 && account == r.accountNbr) {
-            checker = 1;
-            break;
-        }
-    }
-    rewind(curr);
-    if (checker == 0)
-    {
-        fclose(curr);
         stayOrReturn(0, "This account does not exist", transferOwner, u);
     }
 
@@ -722,52 +609,11 @@ validAcc:
     scanf("%99s", username);
     clearStdin();
 
-    checker = 0;
-    if ((user = fopen(USERS,"r")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-
-    while (getUser(user, &p))
-    {
-        if (strcmp(p.name, username) == 0)
-        {
-            checker = 1;
-            userId = p.id;
-            break;
-        }
-    }
-    fclose(user);
-
-    if (checker == 0)
-    {
-        fclose(curr);
-        stayOrReturn(0, "The user provided does not exist", transferOwner, u);
-    }
-
-    if((temp = fopen("./data/temp.txt", "w")) == NULL)
-    {
-        printf("Error! opening file");
-        exit(1);
-    }
-
-    while (getAccountFromFile(curr, &r))
+    int result = giveAccount(u, account, username);
+    if (result != OP_OK)
     {
-        if (strcmp(u.name, r.name) == 0 && r.accountNbr == account)
-        {
-            strncpy(r.name, username, sizeof(r.name) - 1);
-            r.name[sizeof(r.name) - 1] = '\0';
-            r.userId = userId;
-        }
-        saveAccountToFile(temp, &r);
+        stayOrReturn(0, opMessage(result), transferOwner, u);
     }
-
-    fclose(curr);
-    fclose(temp);
-    remove(RECORDS);
-    rename("./data/temp.txt", RECORDS);
-
     success(u);
 
 }
@@ -782,6 +628,15 @@ void toLowerCase(char *str) {
     }
 }
 
+/**
+ * Clears the terminal with the escape sequences clear(1) writes, without
+ * forking a shell.
+ */
+void clearScreen(void) {
+    fputs("\033[H\033[2J\033[3J", stdout);
+    fflush(stdout);
+}
+
 /**
  * Clears the standard input buffer.
  */
@@ -848,11 +703,7 @@ int checkValidType(const char *input, const char *type) {
  * Returns 0 if valid, 1 if invalid.
  */
 int checkValidAccount(const char *accountType) {
-    const char *accounts[] = {"saving", "current", "fixed01", "fixed02", "fixed03"};
-    for (int i = 0; i < 5; i++) {
-        if (strcmp(accountType, accounts[i]) == 0) return 0;
-    }
-    return 1;
+    return accountTypeCode(accountType) == TYPE_UNKNOWN;
 }
 
 /**
@@ -919,7 +770,7 @@ void stayOrReturn(int notGood, const char *message, void (*retryFunc)(struct Use
     int option;
 
     if (notGood == 0) {
-        system("clear");
+        clearScreen();
         printf("\n✖ %s!!\n", message);
     invalid:
         printf("\nEnter 0 to try again, 1 to return to main menu and 2 to exit: ");
@@ -954,10 +805,10 @@ void stayOrReturn(int notGood, const char *message, void (*retryFunc)(struct Use
         sscanf(buffer, "%d", &option);
 
         if (option == 1) {
-            system("clear");
+            clearScreen();
             mainMenu(u);
         } else {
-            system("clear");
+            clearScreen();
             exit(1);
         }
     }
@@ -981,7 +832,7 @@ invalid:
     }
     sscanf(buffer, "%d", &option);
 
-    system("clear");
+    clearScreen();
     if (option == 1) {
         mainMenu(u);
     } else if (option == 0) {
@@ -0,0 +1,221 @@
+/**
+ * @file uring.c
+ * @brief Minimal io_uring client of the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * Just enough of io_uring, on the raw system calls, to write a buffer at
+ * an offset and sync it with a single io_uring_enter: the write and the
+ * fdatasync are linked, so the sync only runs once the write succeeded.
+ * A short write is resubmitted for the rest of the buffer, and entries the
+ * kernel did not take in one io_uring_enter are submitted again.
+ *
+ * IORING_OP_WRITE needs Linux 5.6; setup probes for it.
+ *
+ * This only saves system calls: uringWrite returns once the write and the
+ * sync completed, so its caller waits for the disk as long as it would in
+ * fdatasync.
+ *
+ * A ring is used by one thread at a time. uringSetup fails where io_uring
+ * is missing or forbidden, and the callers then fall back to write(2) and
+ * fdatasync(2).
+ */
+
+#include "header.h"
+#include <errno.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define URING_ENTRIES 8     ///< Submission slots, a write and a sync need two
+
+/**
+ * @brief Mapped rings of one io_uring instance
+ */
+struct Uring
+{
+    int fd;                         ///< io_uring descriptor
+    unsigned int *sqTail;           ///< Submission ring tail, written by us
+    unsigned int *sqMask;
+    unsigned int *sqArray;          ///< Submission ring of sqe indexes
+    struct io_uring_sqe *sqes;      ///< Submission entries
+    unsigned int *cqHead;           ///< Completion ring head, written by us
+    unsigned int *cqTail;
+    unsigned int *cqMask;
+    struct io_uring_cqe *cqes;      ///< Completion entries
+    void *ring;                     ///< Mapping of both rings
+    size_t ringSize;
+    size_t sqesSize;
+};
+
+/**
+ * @brief Set an io_uring instance up
+ * @return The ring, NULL if io_uring is not available
+ */
+struct Uring *uringSetup(void)
+{
+    struct io_uring_params p = {0};
+    struct Uring *u;
+    int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+
+    if (fd < 0)
+        return NULL;
+    // one mapping for both rings needs IORING_FEAT_SINGLE_MMAP (Linux 5.4)
+    struct io_uring_probe *probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+    int usable = probe != NULL && (p.features & IORING_FEAT_SINGLE_MMAP) &&
+                 syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                 probe->ops_len > IORING_OP_WRITE && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    if (!usable || (u = calloc(1, sizeof(struct Uring))) == NULL)
+    {
+        close(fd);
+        return NULL;
+    }
+    u->fd = fd;
+    u->ringSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    if (p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe) > u->ringSize)
+        u->ringSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    char *ring = mmap(NULL, u->ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    u->sqes = mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring == MAP_FAILED || u->sqes == MAP_FAILED)
+    {
+        if (ring != MAP_FAILED)
+            munmap(ring, u->ringSize);
+        close(fd);
+        free(u);
+        return NULL;
+    }
+    u->ring = ring;
+    u->sqTail = (unsigned int *)(ring + p.sq_off.tail);
+    u->sqMask = (unsigned int *)(ring + p.sq_off.ring_mask);
+    u->sqArray = (unsigned int *)(ring + p.sq_off.array);
+    u->cqHead = (unsigned int *)(ring + p.cq_off.head);
+    u->cqTail = (unsigned int *)(ring + p.cq_off.tail);
+    u->cqMask = (unsigned int *)(ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+    return u;
+}
+
+/**
+ * @brief Release an io_uring instance
+ */
+void uringClose(struct Uring *u)
+{
+    if (u == NULL)
+        return;
+    munmap(u->sqes, u->sqesSize);
+    munmap(u->ring, u->ringSize);
+    close(u->fd);
+    free(u);
+}
+
+/**
+ * @brief Fill the next submission entry
+ */
+static struct io_uring_sqe *nextEntry(struct Uring *u, unsigned int *tail)
+{
+    unsigned int index = *tail & *u->sqMask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    u->sqArray[index] = index;
+    (*tail)++;
+    return sqe;
+}
+
+/**
+ * @brief Write a buffer at an offset, and sync the file in the same submission
+ *
+ * @param u Ring
+ * @param fd File to write
+ * @param data Bytes to write
+ * @param length Number of bytes
+ * @param offset Offset of the first byte in the file
+ * @param sync 1 to sync the file once written, 0 to only write
+ * @return 0 on success, -1 on error with errno set
+ */
+int uringWrite(struct Uring *u, int fd, const void *data, size_t length, long long offset, int sync)
+{
+    while (length > 0)
+    {
+        unsigned int tail = *u->sqTail;
+        struct io_uring_sqe *sqe = nextEntry(u, &tail);
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long)data;
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->flags = sync ? IOSQE_IO_LINK : 0;
+        sqe->user_data = 0;
+
+        if (sync)
+        {
+            sqe = nextEntry(u, &tail);
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = fd;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe->user_data = 1;
+        }
+        __atomic_store_n(u->sqTail, tail, __ATOMIC_RELEASE);
+
+        // every entry completes; a failed or short write cancels the sync
+        int entries = sync ? 2 : 1;
+        int unsubmitted = entries;
+        int inFlight = 0;
+        int written = 0;
+        int synced = 0;
+        for (int reaped = 0; reaped < entries;)
+        {
+            // the rest of a short submission goes once the first part completed,
+            // so a sync split from its write still runs after it
+            if (inFlight == 0 && unsubmitted > 0)
+            {
+                int submitted = syscall(__NR_io_uring_enter, u->fd, unsubmitted, unsubmitted,
+                                        IORING_ENTER_GETEVENTS, NULL, 0);
+                if (submitted < 0 && errno == EINTR)
+                    continue;
+                if (submitted <= 0)
+                {
+                    if (submitted == 0)
+                        errno = EAGAIN;
+                    return -1;
+                }
+                unsubmitted -= submitted;
+                inFlight += submitted;
+                continue;
+            }
+            unsigned int head = *u->cqHead;
+            if (head == __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE))
+            {
+                if (syscall(__NR_io_uring_enter, u->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+                    return -1;
+                continue;
+            }
+            struct io_uring_cqe *cqe = &u->cqes[head & *u->cqMask];
+            if (cqe->user_data == 0)
+                written = cqe->res;
+            else
+                synced = cqe->res;
+            __atomic_store_n(u->cqHead, head + 1, __ATOMIC_RELEASE);
+            inFlight--;
+            reaped++;
+        }
+        if (written < 0 || (synced < 0 && synced != -ECANCELED))
+        {
+            errno = written < 0 ? -written : -synced;
+            return -1;
+        }
+        if (written == 0)
+        {
+            errno = EIO;
+            return -1;
+        }
+        data = (const char *)data + written;
+        length -= written;
+        offset += written;
+    }
+    return 0;
+}
@@ -0,0 +1,609 @@
+/**
+ * @file wal.c
+ * @brief Append-only transaction log for the ATM Management System
+ * @author Khalid Hussein
+ * @date 2025
+ *
+ * Every change to an account is appended to the log and synced to disk
+ * before it is acknowledged, so a transaction costs one small write no
+ * matter how large the records file is. The records file is only rebuilt
+ * at checkpoints, after which the log is truncated.
+ *
+ * Each entry is a single line terminated by ';':
+ *   U <record in records file format> ;   insert or replace an account
+ *   D <account number> ;                  delete an account
+ *   M <account> <balance> <account> <balance> ;
+ *                                         set the balances of both sides of a move
+ *   O <user id> <name> <count> <account>... ;
+ *                                         give these accounts to an owner
+ *
+ * Entries carry whole records, whole balances or the owner of every
+ * account they name, never a change relative to the state they are
+ * replayed over, so replaying an entry twice, or over a records file that
+ * already holds it, is harmless. A move or a change of owner is a single
+ * entry, so it is replayed whole or, torn by a crash, not at all.
+ * Appends from concurrent sessions are serialized by the log lock; the
+ * entry is formatted before the lock is taken.
+ *
+ * Appends are made durable by group commit. appendLog only copies the
+ * entry into the pending buffer; syncLog then waits until it is on disk.
+ * The first waiter becomes the leader of a batch: it waits up to the group
+ * commit window for more entries, swaps the pending buffer for an empty
+ * one and writes and syncs the batch with the log lock released, so
+ * appends go on into the new buffer meanwhile. The other waiters sleep
+ * until a sync covers their last entry. Callers release their account
+ * locks before syncLog, so transactions of one batch do not wait on each
+ * other.
+ *
+ * The batch is written with pwrite and fdatasync, or, once setLogBackend
+ * turned it on, through io_uring as a write linked to an fdatasync that
+ * cost a single system call together. Either way the leader waits for the
+ * disk in that call; only the other waiters sleep on the condition
+ * variable.
+ *
+ * A snapshot rotates the log: the current log is renamed to
+ * records.log.<generation> and a new empty log is started. The rotated
+ * logs are removed once a snapshot covering them is on disk.
+ */
+
+#include "header.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+const char *LOG = "./data/records.log";
+
+/**
+ * @brief Growable buffer of log bytes
+ */
+struct LogBuffer
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+static int logFd = -1;  ///< Log opened for writing
+static long long logOffset;     ///< Offset where the next batch is written
+static struct LogBuffer pending;    ///< Entries appended but not written yet
+static struct LogBuffer writing;    ///< Batch the leader is writing
+static struct Uring *ring;      ///< io_uring of the log, NULL for pwrite and fdatasync
+static int logEntries;  ///< Entries written since the last checkpoint
+static int logSync = 1; ///< Sync every append to disk
+static pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long writtenSeq;    ///< Entries appended since the log was opened
+static long long durableSeq;    ///< Entries known to be on disk
+static int syncing;             ///< A leader is running a group commit
+static long long lastBatch;     ///< Entries made durable by the last group commit
+static long long batchWanted;   ///< Pending entries the leader is waiting for
+static int groupEntries = GROUP_COMMIT_ENTRIES; ///< Pending entries that end the window early
+static int groupMicros = GROUP_COMMIT_USEC;     ///< Longest time a leader waits for more entries
+static pthread_cond_t batchFull = PTHREAD_COND_INITIALIZER;   ///< Enough entries for the leader
+static pthread_cond_t logDurable = PTHREAD_COND_INITIALIZER;  ///< durableSeq moved or the leader left
+static __thread long long threadSeq;    ///< Last entry appended by the calling thread
+static int logGeneration;       ///< Generation of the last rotated log
+
+/**
+ * @brief Open the log for appending
+ *
+ * A torn entry left at the end of the log by a crash is cut off first, so
+ * new entries do not land behind it.
+ *
+ * @param entries Number of entries already in the log
+ * @param end Offset just past the last complete entry
+ * @param generation Last rotated log generation in use, new rotations come after it
+ */
+void openLog(int entries, long end, int generation)
+{
+    static int flushAtExit;
+
+    if (logFd != -1)
+        close(logFd);
+    if ((logFd = open(LOG, O_WRONLY | O_CREAT, 0666)) == -1 || ftruncate(logFd, end) != 0)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    logOffset = end;
+    pending.length = 0;
+    logEntries = entries;
+    logGeneration = generation;
+    if (!flushAtExit)
+    {
+        // unsynced appends, when syncing is off, are written out on exit
+        atexit(flushLog);
+        flushAtExit = 1;
+    }
+}
+
+/**
+ * @brief Write bytes at the end of the log, assumes no other thread writes the log
+ *
+ * @param data Bytes to write
+ * @param length Number of bytes
+ * @param offset Offset of the first byte in the log
+ * @param sync 1 to make the bytes durable
+ */
+static void writeLog(const char *data, size_t length, long long offset, int sync)
+{
+    int failed = 0;
+
+    if (ring != NULL)
+    {
+        failed = uringWrite(ring, logFd, data, length, offset, sync) != 0;
+    }
+    else
+    {
+        while (length > 0 && !failed)
+        {
+            ssize_t n = pwrite(logFd, data, length, offset);
+            if (n < 0 && errno == EINTR)
+                continue;
+            failed = n <= 0;
+            data += n;
+            length -= n;
+            offset += n;
+        }
+        if (!failed && sync)
+            failed = fdatasync(logFd) != 0;
+    }
+    if (failed)
+    {
+        printf("Error! writing the transaction log");
+        exit(1);
+    }
+}
+
+/**
+ * @brief Write the pending entries, assumes the log lock is held and no leader runs
+ */
+static void writePending(int sync)
+{
+    writeLog(pending.data, pending.length, logOffset, sync);
+    logOffset += pending.length;
+    pending.length = 0;
+}
+
+/**
+ * @brief Write out the entries appended while syncing was off
+ */
+void flushLog(void)
+{
+    pthread_mutex_lock(&logLock);
+    if (logFd != -1 && !syncing && pending.length > 0)
+        writePending(0);
+    pthread_mutex_unlock(&logLock);
+}
+
+/**
+ * @brief Choose how batches are written
+ *
+ * @param useUring 1 for io_uring, 0 for pwrite and fdatasync
+ * @return 1 if io_uring is in use, 0 if it was not wanted or is not available
+ */
+int setLogBackend(int useUring)
+{
+    pthread_mutex_lock(&logLock);
+    // the leader may be writing through the ring about to be replaced
+    while (syncing)
+    {
+        pthread_cond_wait(&logDurable, &logLock);
+    }
+    if (useUring && ring == NULL)
+        ring = uringSetup();
+    else if (!useUring && ring != NULL)
+    {
+        uringClose(ring);
+        ring = NULL;
+    }
+    int active = ring != NULL;
+    pthread_mutex_unlock(&logLock);
+    return active;
+}
+
+/**
+ * @brief Get the path of a rotated log
+ */
+static void rotatedLogPath(char *path, size_t size, int generation)
+{
+    snprintf(path, size, "%s.%d", LOG, generation);
+}
+
+/**
+ * @brief Compare two generations for qsort
+ */
+static int compareGeneration(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/**
+ * @brief List the generations of the rotated logs, oldest first
+ *
+ * @param generations Receives the generations, at most max of them
+ * @return Number of rotated logs found
+ */
+int rotatedLogs(int *generations, int max)
+{
+    const char *name = strrchr(LOG, '/') + 1;
+    size_t length = strlen(name);
+    struct dirent *entry;
+    DIR *dir;
+    int count = 0;
+
+    if ((dir = opendir("./data")) == NULL)
+        return 0;
+    while ((entry = readdir(dir)) != NULL && count < max)
+    {
+        if (strncmp(entry->d_name, name, length) == 0 && entry->d_name[length] == '.' &&
+            checkValidType(entry->d_name + length + 1, "int") == 0)
+        {
+            generations[count++] = atoi(entry->d_name + length + 1);
+        }
+    }
+    closedir(dir);
+    qsort(generations, count, sizeof(int), compareGeneration);
+    return count;
+}
+
+/**
+ * @brief Open a rotated log for reading, NULL if it does not exist
+ */
+FILE *openRotatedLog(int generation)
+{
+    char path[64];
+    rotatedLogPath(path, sizeof(path), generation);
+    return fopen(path, "r");
+}
+
+/**
+ * @brief Remove the rotated logs up to a generation, once a snapshot covers them
+ */
+void removeRotatedLogs(int generation)
+{
+    int generations[MAX_ROTATED_LOGS];
+    int count = rotatedLogs(generations, MAX_ROTATED_LOGS);
+    char path[64];
+
+    for (int i = 0; i < count && generations[i] <= generation; i++)
+    {
+        rotatedLogPath(path, sizeof(path), generations[i]);
+        remove(path);
+    }
+}
+
+/**
+ * @brief Move the current log aside and start a new one
+ *
+ * Every entry written so far is synced first, so its waiters are released.
+ *
+ * @return Generation of the rotated log
+ */
+int rotateLog(void)
+{
+    char path[64];
+
+    pthread_mutex_lock(&logLock);
+    // a leader may be running fsync on the descriptor about to be closed
+    while (syncing)
+    {
+        pthread_cond_wait(&logDurable, &logLock);
+    }
+    writePending(1);
+    close(logFd);
+    rotatedLogPath(path, sizeof(path), ++logGeneration);
+    if (rename(LOG, path) != 0 || (logFd = open(LOG, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+    {
+        printf("Error! opening file");
+        exit(1);
+    }
+    logOffset = 0;
+    logEntries = 0;
+    durableSeq = writtenSeq;
+    pthread_cond_broadcast(&logDurable);
+    int generation = logGeneration;
+    pthread_mutex_unlock(&logLock);
+    return generation;
+}
+
+/**
+ * @brief Read one entry from the log
+ *
+ * A torn entry left by a crash in the middle of an append is reported as
+ * the end of the log.
+ *
+ * @param ptr Pointer to the file stream
+ * @param op Receives the entry type, 'U', 'D', 'M' or 'O'
+ * @param r Receives the record, only the account number is set for 'D',
+ *          the account number and balance of the debited account for 'M',
+ *          the number of accounts given as the account number for 'O'
+ * @param to Receives the account number and balance of the credited account
+ *           for 'M', the new owner for 'O'
+ * @param accounts Buffer receiving the accounts given for 'O', reallocated
+ *                 as needed, to free once the log is read
+ * @return 1 if a complete entry was read, 0 at the end of the log
+ */
+int getLogEntry(FILE *ptr, char *op, struct Record *r, struct Record *to, int **accounts)
+{
+    char end;
+
+    if (fscanf(ptr, " %c", op) != 1)
+        return 0;
+
+    if (*op == 'U')
+    {
+        if (!getAccountFromFile(ptr, r))
+            return 0;
+    }
+    else if (*op == 'D')
+    {
+        if (fscanf(ptr, "%d", &r->accountNbr) != 1)
+            return 0;
+    }
+    else if (*op == 'M')
+    {
+        if (fscanf(ptr, "%d %lf %d %lf", &r->accountNbr, &r->amount, &to->accountNbr, &to->amount) != 4)
+            return 0;
+    }
+    else if (*op == 'O')
+    {
+        if (fscanf(ptr, "%d %49s %d", &to->userId, to->name, &r->accountNbr) != 3 || r->accountNbr < 1 ||
+            (*accounts = realloc(*accounts, (size_t)r->accountNbr * sizeof(int))) == NULL)
+            return 0;
+        for (int i = 0; i < r->accountNbr; i++)
+        {
+            if (fscanf(ptr, "%d", &(*accounts)[i]) != 1)
+                return 0;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+    return fscanf(ptr, " %c", &end) == 1 && end == ';';
+}
+
+/**
+ * @brief Copy a formatted entry into the pending buffer
+ */
+static void appendEntry(const char *line, int length)
+{
+    pthread_mutex_lock(&logLock);
+    if (pending.length + length > pending.capacity)
+    {
+        // a change of owner entry may be larger than the buffer doubled
+        while (pending.length + length > pending.capacity)
+        {
+            pending.capacity = pending.capacity ? pending.capacity * 2 : LOG_BUFFER_SIZE;
+        }
+        if ((pending.data = realloc(pending.data, pending.capacity)) == NULL)
+        {
+            printf("Error! out of memory");
+            exit(1);
+        }
+    }
+    memcpy(pending.data + pending.length, line, length);
+    pending.length += length;
+    // with syncing off no leader ever writes, so the buffer is written when full
+    if (!logSync && !syncing && pending.length >= LOG_BUFFER_SIZE)
+        writePending(0);
+    logEntries++;
+    threadSeq = ++writtenSeq;
+    if (syncing && writtenSeq - durableSeq == batchWanted)
+        pthread_cond_signal(&batchFull);
+    pthread_mutex_unlock(&logLock);
+    statsWritten(length);
+}
+
+/**
+ * @brief Append an entry to the log buffer
+ *
+ * The entry is durable only once syncLog returns.
+ *
+ * @param op Entry type, 'U' or 'D'
+ * @param r Record to log, only the account number is used for 'D'
+ */
+void appendLog(char op, const struct Record *r)
+{
+    char line[LOG_ENTRY_SIZE];
+    int length;
+
+    if (op == 'U')
+    {
+        length = snprintf(line, sizeof(line), "U %d %d %s %d %d/%d/%d %s %d %.2lf %s ;\n",
+                r->id,
+                r->userId,
+                r->name,
+                r->accountNbr,
+                r->deposit.month,
+                r->deposit.day,
+                r->deposit.year,
+                r->country,
+                r->phone,
+                r->amount,
+                r->accountType);
+    }
+    else
+    {
+        length = snprintf(line, sizeof(line), "D %d ;\n", r->accountNbr);
+    }
+    appendEntry(line, length);
+}
+
+/**
+ * @brief Append the entry of a move between two accounts to the log buffer
+ *
+ * The entry is durable only once syncLog returns.
+ *
+ * @param fromNbr Debited account
+ * @param fromAmount New balance of the debited account
+ * @param toNbr Credited account
+ * @param toAmount New balance of the credited account
+ */
+void appendMove(int fromNbr, double fromAmount, int toNbr, double toAmount)
+{
+    char line[LOG_ENTRY_SIZE];
+    int length = snprintf(line, sizeof(line), "M %d %.2lf %d %.2lf ;\n", fromNbr, fromAmount, toNbr, toAmount);
+
+    appendEntry(line, length);
+}
+
+/**
+ * @brief Append the entry of a change of owner to the log buffer
+ *
+ * The entry is durable only once syncLog returns.
+ *
+ * @param toId Id of the new owner
+ * @param toName Name of the new owner
+ * @param accounts Numbers of the accounts given
+ * @param count Number of accounts given
+ */
+void appendReassign(int toId, const char *toName, const int *accounts, int count)
+{
+    // an account number takes at most 11 characters and a space
+    char *line = malloc(LOG_ENTRY_SIZE + (size_t)count * 12);
+    if (line == NULL)
+    {
+        printf("Error! out of memory");
+        exit(1);
+    }
+    int length = sprintf(line, "O %d %s %d", toId, toName, count);
+    for (int i = 0; i < count; i++)
+    {
+        length += sprintf(line + length, " %d", accounts[i]);
+    }
+    length += sprintf(line + length, " ;\n");
+
+    appendEntry(line, length);
+    free(line);
+}
+
+/**
+ * @brief Wait for the end of the group commit window, assumes the log lock is held
+ *
+ * The size of the last batch is the best guess of how many callers are
+ * writing, so the window ends as soon as that many entries are pending,
+ * or groupEntries if fewer. A lone writer thus never waits.
+ */
+static void waitForBatch(void)
+{
+    struct timespec until;
+
+    batchWanted = lastBatch < groupEntries ? lastBatch : groupEntries;
+    if (groupMicros <= 0 || writtenSeq - durableSeq >= batchWanted)
+        return;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += groupMicros * 1000L;
+    until.tv_sec += until.tv_nsec / 1000000000L;
+    until.tv_nsec %= 1000000000L;
+    while (writtenSeq - durableSeq < batchWanted)
+    {
+        if (pthread_cond_timedwait(&batchFull, &logLock, &until) == ETIMEDOUT)
+            break;
+    }
+}
+
+/**
+ * @brief Wait until every entry appended by the calling thread is on disk
+ *
+ * Does nothing when syncing is turned off.
+ */
+void syncLog(void)
+{
+    pthread_mutex_lock(&logLock);
+    while (logSync && durableSeq < threadSeq)
+    {
+        if (syncing)
+        {
+            pthread_cond_wait(&logDurable, &logLock);
+            continue;
+        }
+
+        syncing = 1;
+        waitForBatch();
+        long long target = writtenSeq;
+        long long offset = logOffset;
+        struct LogBuffer batch = pending;
+        pending = writing;
+        pending.length = 0;
+        logOffset += batch.length;
+        pthread_mutex_unlock(&logLock);
+        writeLog(batch.data, batch.length, offset, 1);
+        pthread_mutex_lock(&logLock);
+        writing = batch;
+        if (target > durableSeq)
+        {
+            lastBatch = target - durableSeq;
+            durableSeq = target;
+        }
+        syncing = 0;
+        pthread_cond_broadcast(&logDurable);
+    }
+    pthread_mutex_unlock(&logLock);
+}
+
+/**
+ * @brief Set the group commit window
+ *
+ * @param entries Pending entries that end the window early
+ * @param micros Longest time a leader waits for more entries, 0 to flush at once
+ */
+void setGroupCommit(int entries, int micros)
+{
+    pthread_mutex_lock(&logLock);
+    groupEntries = entries > 0 ? entries : 1;
+    groupMicros = micros;
+    pthread_mutex_unlock(&logLock);
+}
+
+/**
+ * @brief Get the number of entries written since the last checkpoint
+ */
+int logSize(void)
+{
+    pthread_mutex_lock(&logLock);
+    int entries = logEntries;
+    pthread_mutex_unlock(&logLock);
+    return entries;
+}
+
+/**
+ * @brief Turn syncing of the appends on or off
+ *
+ * Only the benchmarks turn it off, to measure the in-memory paths alone.
+ */
+void setLogSync(int sync)
+{
+    logSync = sync;
+}
+
+/**
+ * @brief Empty the log once its entries are part of the records file
+ *
+ * The records file was synced first, so every entry written so far is
+ * durable and its waiters are released.
+ */
+void truncateLog(void)
+{
+    pthread_mutex_lock(&logLock);
+    // a leader may be running fsync on the descriptor about to be replaced
+    while (syncing)
+    {
+        pthread_cond_wait(&logDurable, &logLock);
+    }
+    if (ftruncate(logFd, 0) != 0)
+    {
+        printf("Error! writing the transaction log");
+        exit(1);
+    }
+    pending.length = 0;
+    logOffset = 0;
+    logEntries = 0;
+    durableSeq = writtenSeq;
+    pthread_cond_broadcast(&logDurable);
+    pthread_mutex_unlock(&logLock);
+}